@@ -0,0 +1,1136 @@
+// -----------------------------
+// projects/deque/BenchDeque.c++
+// Copyright (C) 2014
+// Glenn P. Downing
+// -----------------------------
+
+/*
+To compile the benchmark:
+    % g++-4.7 -O2 -pedantic -std=c++11 BenchDeque.c++ -o BenchDeque -lpthread
+
+To run the benchmark:
+    % BenchDeque
+
+To write the my_deque/std::deque/std::vector suite as CSV, sizes 10 to max_n:
+    % BenchDeque --csv [max_n] > BenchDeque.csv
+*/
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // equal, lexicographical_compare, min, sort
+#include <atomic>   // atomic
+#include <chrono>   // steady_clock
+#include <cstddef>  // size_t
+#include <cstdlib>  // getenv, strtoull
+#include <cstring>  // memset, strcmp
+#include <deque>    // deque
+#include <fstream>  // ifstream
+#include <functional> // hash
+#include <iomanip>  // setw
+#include <iostream> // cout, endl, ostream
+#include <memory>   // unique_ptr
+#include <mutex>    // lock_guard, mutex
+#include <sstream>  // stringstream
+#include <new>      // bad_alloc, operator new
+#include <string>   // string, to_string
+#include <thread>   // hardware_concurrency, thread, yield
+#include <type_traits> // false_type, true_type
+#include <vector>   // vector
+
+#include <unistd.h> // getpid, sysconf, unlink
+
+#ifdef __GLIBC__
+#include <malloc.h> // malloc_trim
+#endif
+
+#include "ConcurrentDeque.h"
+#include "Deque.h"
+#include "MappedDeque.h"
+#include "ParallelDeque.h"
+#include "RingDeque.h"
+#include "SpscDeque.h"
+#include "WorkStealingDeque.h"
+
+// -------
+// elapsed
+// -------
+
+typedef std::chrono::steady_clock bench_clock;
+
+double elapsed_ms (bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();}
+
+// ---------------
+// bench_block_size
+// ---------------
+
+/**
+ * Times n push_backs followed by one range-for pass over the deque.
+ */
+template <std::size_t B>
+void bench_block_size (const char* label, std::size_t n) {
+    typedef my_deque<int, std::allocator<int>, B> deque_type;
+
+    bench_clock::time_point start = bench_clock::now();
+    deque_type x;
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(static_cast<int>(i));
+    const double push_ms = elapsed_ms(start);
+
+    start = bench_clock::now();
+    long long sum = 0;
+    for (int v : x)
+        sum += v;
+    const double iterate_ms = elapsed_ms(start);
+
+    std::cout << std::setw(10) << label
+              << std::setw(10) << B
+              << std::setw(14) << push_ms
+              << std::setw(14) << iterate_ms
+              << std::setw(20) << sum << std::endl;}
+
+// ----------
+// bench_spsc
+// ----------
+
+/**
+ * Hands n ints from a producer thread to a consumer thread through
+ * spsc_deque and through a mutex-wrapped my_deque.
+ */
+void bench_spsc (std::size_t n) {
+    bench_clock::time_point start = bench_clock::now();
+    {
+        spsc_deque<std::size_t> q;
+        std::thread producer([&q, n] () {
+            for (std::size_t i = 0; i != n; ++i)
+                q.push_back(i);});
+        std::size_t v;
+        for (std::size_t i = 0; i != n; )
+            if (q.try_pop_front(v))
+                ++i;
+            else
+                std::this_thread::yield();
+        producer.join();
+    }
+    const double spsc_ms = elapsed_ms(start);
+
+    start = bench_clock::now();
+    {
+        my_deque<std::size_t> q;
+        std::mutex m;
+        std::thread producer([&q, &m, n] () {
+            for (std::size_t i = 0; i != n; ++i) {
+                std::lock_guard<std::mutex> lock(m);
+                q.push_back(i);}});
+        for (std::size_t i = 0; i != n; ) {
+            bool popped = false;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (!q.empty()) {
+                    q.pop_front();
+                    popped = true;}
+            }
+            if (popped)
+                ++i;
+            else
+                std::this_thread::yield();}
+        producer.join();
+    }
+    const double mutex_ms = elapsed_ms(start);
+
+    std::cout << std::setw(24) << "spsc_deque"        << std::setw(14) << spsc_ms
+              << std::setw(14) << n / spsc_ms / 1000  << " M/s" << std::endl;
+    std::cout << std::setw(24) << "mutex + my_deque"  << std::setw(14) << mutex_ms
+              << std::setw(14) << n / mutex_ms / 1000 << " M/s" << std::endl;}
+
+// ----------------
+// bench_contention
+// ----------------
+
+/**
+ * my_deque behind one mutex, the baseline for concurrent_deque.
+ */
+template <typename T>
+class locked_deque {
+    private:
+        my_deque<T> _x;
+        std::mutex  _m;
+
+    public:
+        void push_back (const T& v) {
+            std::lock_guard<std::mutex> lock(_m);
+            _x.push_back(v);}
+
+        bool try_pop_front (T& v) {
+            std::lock_guard<std::mutex> lock(_m);
+            if (_x.empty())
+                return false;
+            v = _x.front();
+            _x.pop_front();
+            return true;}};
+
+/**
+ * Half of the threads push_back n / (threads / 2) ints each while the other
+ * half try_pop_front until all n have been taken. Returns milliseconds.
+ */
+template <typename Q>
+double contention_ms (std::size_t threads, std::size_t n) {
+    Q q;
+    const std::size_t producers = threads / 2;
+    const std::size_t per_thread = n / producers;
+    std::atomic<std::size_t> remaining(producers * per_thread);
+    std::vector<std::thread> pool;
+    bench_clock::time_point start = bench_clock::now();
+    for (std::size_t k = 0; k != producers; ++k)
+        pool.push_back(std::thread([&q, per_thread] () {
+            for (std::size_t i = 0; i != per_thread; ++i)
+                q.push_back(static_cast<int>(i));}));
+    for (std::size_t k = producers; k != threads; ++k)
+        pool.push_back(std::thread([&q, &remaining] () {
+            int v;
+            while (remaining.load(std::memory_order_relaxed) != 0)
+                if (q.try_pop_front(v))
+                    remaining.fetch_sub(1, std::memory_order_relaxed);
+                else
+                    std::this_thread::yield();}));
+    for (std::thread& t : pool)
+        t.join();
+    return elapsed_ms(start);}
+
+/**
+ * Producer/consumer contention from 2 to 32 threads.
+ */
+void bench_contention (std::size_t n) {
+    for (std::size_t threads = 2; threads <= 32; threads *= 2)
+        std::cout << std::setw(10) << threads
+                  << std::setw(20) << contention_ms<concurrent_deque<int>>(threads, n)
+                  << std::setw(20) << contention_ms<locked_deque<int>>(threads, n) << std::endl;}
+
+// --------------
+// bench_parallel
+// --------------
+
+/**
+ * parallel_for_each, parallel_transform, parallel_reduce and parallel_sort
+ * over n ints on 1 to N threads, against the serial block-wise versions.
+ */
+void bench_parallel (std::size_t n) {
+    my_deque<int> x;
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(static_cast<int>(i * 2654435761u % 1000003));
+    my_deque<int> y(x.size());
+    const my_deque<int> source(x);
+
+    bench_clock::time_point start = bench_clock::now();
+    for_each(x.begin(), x.end(), [] (int& v) {v = v * 3 + 1;});
+    const double for_each_ms = elapsed_ms(start);
+    start = bench_clock::now();
+    long long sum = accumulate(x.begin(), x.end(), 0LL);
+    const double reduce_ms = elapsed_ms(start);
+    start = bench_clock::now();
+    std::sort(x.begin(), x.end());
+    const double sort_ms = elapsed_ms(start);
+    std::cout << std::setw(10) << "serial"
+              << std::setw(14) << for_each_ms
+              << std::setw(14) << "-"
+              << std::setw(14) << reduce_ms
+              << std::setw(14) << sort_ms
+              << std::setw(20) << sum << std::endl;
+
+    std::size_t cores = parallel_threads(0);
+    for (std::size_t threads = 1; ; threads = std::min(2 * threads, cores)) {
+        x = source;
+        start = bench_clock::now();
+        parallel_for_each(x.begin(), x.end(), [] (int& v) {v = v * 3 + 1;}, threads);
+        const double for_each_ms = elapsed_ms(start);
+        start = bench_clock::now();
+        parallel_transform(x.begin(), x.end(), y.begin(), [] (int v) {return v / 2;}, threads);
+        const double transform_ms = elapsed_ms(start);
+        start = bench_clock::now();
+        sum = parallel_reduce(x.begin(), x.end(), 0LL, [] (long long a, long long b) {return a + b;}, threads);
+        const double reduce_ms = elapsed_ms(start);
+        start = bench_clock::now();
+        parallel_sort(x.begin(), x.end(), std::less<int>(), threads);
+        const double sort_ms = elapsed_ms(start);
+        std::cout << std::setw(10) << threads
+                  << std::setw(14) << for_each_ms
+                  << std::setw(14) << transform_ms
+                  << std::setw(14) << reduce_ms
+                  << std::setw(14) << sort_ms
+                  << std::setw(20) << sum << std::endl;
+        if (threads == cores)
+            break;}}
+
+// ------------------
+// work_stealing_pool
+// ------------------
+
+/**
+ * Minimal fork/join pool: one work_stealing_deque per worker. A worker runs
+ * its own newest task first and steals the oldest task of another worker
+ * when it runs dry. Worker 0 is the thread that calls run.
+ */
+class work_stealing_pool {
+    public:
+        struct task {
+            void (*execute) (task*, work_stealing_pool&, std::size_t);
+            std::atomic<bool> done;
+
+            explicit task (void (*f) (task*, work_stealing_pool&, std::size_t)) :
+                    execute (f),
+                    done    (false)
+                {}};
+
+    private:
+        std::vector<std::unique_ptr<work_stealing_deque<task*>>> _queues;
+        std::vector<std::thread> _threads;
+        std::atomic<bool> _stop;
+
+        bool run_one (std::size_t w) {
+            task* t;
+            if (!_queues[w]->pop_back(t)) {
+                std::size_t i = 1;
+                while ((i != _queues.size()) && !_queues[(w + i) % _queues.size()]->steal(t))
+                    ++i;
+                if (i == _queues.size())
+                    return false;}
+            t->execute(t, *this, w);
+            t->done.store(true, std::memory_order_release);
+            return true;}
+
+    public:
+        explicit work_stealing_pool (std::size_t n) :
+                _stop (false) {
+            for (std::size_t w = 0; w != n; ++w)
+                _queues.push_back(std::unique_ptr<work_stealing_deque<task*>>(new work_stealing_deque<task*>));
+            for (std::size_t w = 1; w != n; ++w)
+                _threads.push_back(std::thread([this, w] () {
+                    while (!_stop.load(std::memory_order_acquire))
+                        if (!run_one(w))
+                            std::this_thread::yield();}));}
+
+        ~work_stealing_pool () {
+            _stop.store(true, std::memory_order_release);
+            for (std::thread& t : _threads)
+                t.join();}
+
+        /**
+         * Makes t available to the other workers. Worker w's thread only.
+         */
+        void spawn (task& t, std::size_t w) {
+            _queues[w]->push_back(&t);}
+
+        /**
+         * Runs other tasks until t is done. Worker w's thread only.
+         */
+        void join (task& t, std::size_t w) {
+            while (!t.done.load(std::memory_order_acquire))
+                if (!run_one(w))
+                    std::this_thread::yield();}
+
+        /**
+         * Runs t on the calling thread as worker 0.
+         */
+        void run (task& t) {
+            t.execute(&t, *this, 0);
+            t.done.store(true, std::memory_order_release);}};
+
+// ---------
+// bench_fib
+// ---------
+
+long fib_serial (int n) {
+    return (n < 2) ? n : fib_serial(n - 1) + fib_serial(n - 2);}
+
+/**
+ * fib(n) forks fib(n - 1) and computes fib(n - 2) itself, down to a cutoff.
+ */
+struct fib_task : work_stealing_pool::task {
+    int  n;
+    long result;
+
+    explicit fib_task (int n) :
+            work_stealing_pool::task (&fib_task::compute),
+            n      (n),
+            result (0)
+        {}
+
+    static void compute (work_stealing_pool::task* t, work_stealing_pool& pool, std::size_t w) {
+        fib_task& self = *static_cast<fib_task*>(t);
+        if (self.n < 20) {
+            self.result = fib_serial(self.n);
+            return;}
+        fib_task left(self.n - 1);
+        fib_task right(self.n - 2);
+        pool.spawn(left, w);
+        compute(&right, pool, w);
+        pool.join(left, w);
+        self.result = left.result + right.result;}};
+
+/**
+ * Times fib(n) on pools of 1 to N workers.
+ */
+void bench_fib (int n) {
+    std::size_t cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        cores = 1;
+    double one_ms = 0;
+    for (std::size_t workers = 1; ; workers = std::min(2 * workers, cores)) {
+        bench_clock::time_point start = bench_clock::now();
+        fib_task root(n);
+        {
+            work_stealing_pool pool(workers);
+            pool.run(root);
+        }
+        const double ms = elapsed_ms(start);
+        if (workers == 1)
+            one_ms = ms;
+        std::cout << std::setw(10) << workers
+                  << std::setw(14) << ms
+                  << std::setw(10) << one_ms / ms << "x"
+                  << std::setw(14) << root.result << std::endl;
+        if (workers == cores)
+            break;}}
+
+// -----------
+// bench_arena
+// -----------
+
+/**
+ * A bump arena that a request resets when it ends.
+ */
+struct bump_arena {
+    std::vector<char> buffer;
+    std::size_t       used;
+
+    explicit bump_arena (std::size_t n) :
+            buffer (n),
+            used   (0)
+        {}
+
+    void* allocate (std::size_t n, std::size_t alignment) {
+        const std::size_t p = (used + alignment - 1) / alignment * alignment;
+        if (p + n > buffer.size())
+            throw std::bad_alloc();
+        used = p + n;
+        return &buffer[p];}
+
+    void reset () {
+        used = 0;}};
+
+template <typename T>
+struct bump_allocator {
+    typedef T value_type;
+
+    bump_arena* _arena;
+
+    explicit bump_allocator (bump_arena& a) :
+            _arena (&a)
+        {}
+
+    template <typename U>
+    bump_allocator (const bump_allocator<U>& that) :
+            _arena (that._arena)
+        {}
+
+    T* allocate (std::size_t n) {
+        return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));}
+
+    void deallocate (T*, std::size_t) {}};
+
+template <typename T, typename U>
+bool operator == (const bump_allocator<T>& lhs, const bump_allocator<U>& rhs) {
+    return lhs._arena == rhs._arena;}
+
+template <typename T, typename U>
+bool operator != (const bump_allocator<T>& lhs, const bump_allocator<U>& rhs) {
+    return !(lhs == rhs);}
+
+/**
+ * Calls to operator new and delete made through heap_allocator.
+ */
+std::size_t heap_calls = 0;
+
+template <typename T>
+struct heap_allocator {
+    typedef T value_type;
+
+    heap_allocator () {}
+
+    template <typename U>
+    heap_allocator (const heap_allocator<U>&) {}
+
+    T* allocate (std::size_t n) {
+        ++heap_calls;
+        return static_cast<T*>(::operator new(n * sizeof(T)));}
+
+    void deallocate (T* p, std::size_t) {
+        ++heap_calls;
+        ::operator delete(p);}};
+
+template <typename T, typename U>
+bool operator == (const heap_allocator<T>&, const heap_allocator<U>&) {
+    return true;}
+
+template <typename T, typename U>
+bool operator != (const heap_allocator<T>&, const heap_allocator<U>&) {
+    return false;}
+
+/**
+ * A request: queue k jobs, drain them into a result deque, summarize it,
+ * throw both deques away, then call end_of_request.
+ */
+template <typename A, typename F>
+long long run_requests (std::size_t requests, std::size_t k, const A& a, F end_of_request) {
+    long long sum = 0;
+    for (std::size_t r = 0; r != requests; ++r) {
+        {
+            my_deque<int, A> pending(a);
+            my_deque<int, A> done(a);
+            for (std::size_t i = 0; i != k; ++i)
+                pending.push_back(static_cast<int>(i + r));
+            while (!pending.empty()) {
+                const int v = pending.front();
+                pending.pop_front();
+                if (v % 3 == 0)
+                    done.push_front(v);
+                else
+                    done.push_back(v);}
+            sum += done.front() + done.back() + static_cast<long long>(done.size());
+        }
+        end_of_request();}
+    return sum;}
+
+/**
+ * The same request-scoped workload on the heap and on an arena that is
+ * reset between requests.
+ */
+void bench_arena (std::size_t requests, std::size_t k) {
+    bench_clock::time_point start = bench_clock::now();
+    long long sum = run_requests(requests, k, std::allocator<int>(), [] () {});
+    std::cout << std::setw(24) << "std::allocator" << std::setw(14) << elapsed_ms(start) << std::setw(14) << "-" << std::setw(20) << sum << std::endl;
+
+    heap_calls = 0;
+    start = bench_clock::now();
+    sum = run_requests(requests, k, heap_allocator<int>(), [] () {});
+    std::cout << std::setw(24) << "counted heap" << std::setw(14) << elapsed_ms(start) << std::setw(14) << heap_calls << std::setw(20) << sum << std::endl;
+
+    bump_arena arena(1 << 20);
+    heap_calls = 0;
+    start = bench_clock::now();
+    sum = run_requests(requests, k, bump_allocator<int>(arena), [&arena] () {arena.reset();});
+    std::cout << std::setw(24) << "arena" << std::setw(14) << elapsed_ms(start) << std::setw(14) << heap_calls << std::setw(20) << sum << std::endl;}
+
+// ----------
+// bench_ring
+// ----------
+
+/**
+ * How long each of n calls f(i) took, in nanoseconds.
+ */
+template <typename F>
+std::vector<double> latencies (std::size_t n, F f) {
+    std::vector<double> ns(n);
+    for (std::size_t i = 0; i != n; ++i) {
+        const bench_clock::time_point start = bench_clock::now();
+        f(i);
+        ns[i] = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();}
+    return ns;}
+
+/**
+ * The columns of latency_row.
+ */
+void latency_header () {
+    std::cout << std::setw(24) << "queue"
+              << std::setw(9) << "p50"
+              << std::setw(9) << "p99"
+              << std::setw(9) << "p99.9"
+              << std::setw(9) << "p99.99"
+              << std::setw(11) << "max" << "  |"
+              << std::setw(9) << "<=64"
+              << std::setw(9) << "<=256"
+              << std::setw(9) << "<=1K"
+              << std::setw(9) << "<=4K"
+              << std::setw(9) << "<=16K"
+              << std::setw(9) << "<=64K"
+              << std::setw(9) << ">64K" << std::endl;}
+
+/**
+ * Percentiles, then counts in buckets that are each four times wider.
+ */
+void latency_row (const char* queue, std::vector<double> ns) {
+    std::sort(ns.begin(), ns.end());
+    const std::size_t n = ns.size();
+    std::cout << std::setw(24) << queue
+              << std::setw(9) << ns[n / 2]
+              << std::setw(9) << ns[n - n / 100]
+              << std::setw(9) << ns[n - n / 1000]
+              << std::setw(9) << ns[n - n / 10000]
+              << std::setw(11) << ns[n - 1] << "  |";
+    double limit = 64;
+    std::vector<double>::const_iterator b = ns.begin();
+    for (int k = 0; k != 6; ++k, limit *= 4) {
+        std::vector<double>::const_iterator e = std::upper_bound(b, ns.cend(), limit);
+        std::cout << std::setw(9) << (e - b);
+        b = e;}
+    std::cout << std::setw(9) << (ns.cend() - b) << std::endl;}
+
+/**
+ * Per-push latency of a telemetry buffer that keeps the last capacity
+ * samples: my_deque growing without bound, my_deque popping the oldest,
+ * and ring_deque overwriting it.
+ */
+void bench_ring (std::size_t n, std::size_t capacity) {
+    {
+        my_deque<int> x;
+        latency_row("my_deque unbounded", latencies(n, [&x] (std::size_t i) {
+            x.push_back(static_cast<int>(i));}));
+    }
+    {
+        my_deque<int> x;
+        latency_row("my_deque pop oldest", latencies(n, [&x, capacity] (std::size_t i) {
+            x.push_back(static_cast<int>(i));
+            if (x.size() > capacity)
+                x.pop_front();}));
+    }
+    {
+        ring_deque<int> x(capacity);
+        latency_row("ring_deque overwrite", latencies(n, [&x] (std::size_t i) {
+            x.push_back_overwrite(static_cast<int>(i));}));
+    }}
+
+// -------------
+// bench_reserve
+// -------------
+
+/**
+ * push_back latency into a fresh my_deque<int>, with and without
+ * reserve_back(n) first.
+ */
+void bench_reserve (std::size_t n) {
+    {
+        my_deque<int> x;
+        latency_row("my_deque", latencies(n, [&x] (std::size_t i) {
+            x.push_back(static_cast<int>(i));}));
+    }
+    {
+        my_deque<int> x;
+        x.reserve_back(n);
+        latency_row("my_deque reserve_back", latencies(n, [&x] (std::size_t i) {
+            x.push_back(static_cast<int>(i));}));
+    }}
+
+// ---------
+// bench_rss
+// ---------
+
+/**
+ * Resident set size in KB from /proc/self/statm, 0 where there is none.
+ */
+std::size_t rss_kb () {
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages    = 0;
+    std::size_t resident = 0;
+    if (!(statm >> pages >> resident))
+        return 0;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) / 1024;}
+
+/**
+ * Hands memory that free kept back to the kernel, where malloc allows it,
+ * and returns the new RSS; what is left is what the deque still holds.
+ */
+std::size_t trimmed_rss_kb () {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    return rss_kb();}
+
+/**
+ * A spike of n elements drained back to 100, with the given shrink threshold.
+ */
+void bench_rss (const char* policy, std::size_t threshold, std::size_t n) {
+    const std::size_t before = rss_kb();
+    my_deque<int> x;
+    x.set_shrink_threshold(threshold);
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(static_cast<int>(i));
+    const std::size_t peak = rss_kb();
+    bench_clock::time_point start = bench_clock::now();
+    while (x.size() > 100)
+        x.pop_front();
+    const double ms = elapsed_ms(start);
+    std::cout << std::setw(24) << policy
+              << std::setw(12) << before
+              << std::setw(12) << peak
+              << std::setw(12) << rss_kb()
+              << std::setw(12) << trimmed_rss_kb()
+              << std::setw(14) << ms << std::endl;}
+
+// --------
+// bench_io
+// --------
+
+/**
+ * Checkpoints n ints to memory and back: element by element through
+ * operator[] and push_back, then with save and load.
+ */
+void bench_io (std::size_t n) {
+    my_deque<int> x;
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_front(static_cast<int>(i));
+    {
+        std::stringstream stream;
+        bench_clock::time_point start = bench_clock::now();
+        const std::uint64_t size = x.size();
+        stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        for (std::size_t i = 0; i != x.size(); ++i)
+            stream.write(reinterpret_cast<const char*>(&x[i]), sizeof(int));
+        const double save_ms = elapsed_ms(start);
+        start = bench_clock::now();
+        my_deque<int> y;
+        std::uint64_t m = 0;
+        stream.read(reinterpret_cast<char*>(&m), sizeof(m));
+        for (; m != 0; --m) {
+            int v;
+            stream.read(reinterpret_cast<char*>(&v), sizeof(v));
+            y.push_back(v);}
+        const double load_ms = elapsed_ms(start);
+        std::cout << std::setw(24) << "per element" << std::setw(14) << save_ms << std::setw(14) << load_ms << std::setw(10) << (x == y) << std::endl;
+    }
+    {
+        std::stringstream stream;
+        bench_clock::time_point start = bench_clock::now();
+        x.save(stream);
+        const double save_ms = elapsed_ms(start);
+        start = bench_clock::now();
+        my_deque<int> y;
+        y.load(stream);
+        const double load_ms = elapsed_ms(start);
+        std::cout << std::setw(24) << "save/load" << std::setw(14) << save_ms << std::setw(14) << load_ms << std::setw(10) << (x == y) << std::endl;
+    }}
+
+// ------------
+// bench_mapped
+// ------------
+
+/**
+ * Pushes n ints at the back, then pops them all from the front, and
+ * prints the throughput of each phase and the RSS after the pushes.
+ */
+template <typename D>
+void sequential_run (const char* queue, D& x, std::size_t n) {
+    const std::size_t before = rss_kb();
+    bench_clock::time_point start = bench_clock::now();
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(static_cast<int>(i));
+    const double push_ms = elapsed_ms(start);
+    const std::size_t pushed = rss_kb();
+    long long sum = 0;
+    start = bench_clock::now();
+    while (!x.empty()) {
+        sum += x.front();
+        x.pop_front();}
+    const double pop_ms = elapsed_ms(start);
+    std::cout << std::setw(24) << queue
+              << std::setw(14) << n / push_ms / 1000
+              << std::setw(14) << n / pop_ms / 1000
+              << std::setw(16) << (pushed > before ? pushed - before : 0)
+              << std::setw(20) << sum << std::endl;}
+
+/**
+ * my_deque against mapped_deque on a file under $TMPDIR, or /tmp.
+ */
+void bench_mapped (std::size_t n) {
+    {
+        my_deque<int> x;
+        sequential_run("my_deque", x, n);
+    }
+    const char* dir = std::getenv("TMPDIR");
+    const std::string path = std::string(dir ? dir : "/tmp") + "/BenchDeque." + std::to_string(getpid()) + ".mapped";
+    {
+        mapped_deque<int> x(path);
+        sequential_run("mapped_deque", x, n);
+    }
+    unlink(path.c_str());}
+
+// -------------
+// bench_compare
+// -------------
+
+/**
+ * Times reps whole-deque comparisons of two equal deques of n Ts, one
+ * built from the back and one from the front so their blocks do not line
+ * up: element-wise std::equal and std::lexicographical_compare against the
+ * block-wise operator== and operator<, and std::hash of the deque.
+ */
+template <typename T>
+void bench_compare (const char* type, std::size_t n, int reps) {
+    my_deque<T> x;
+    my_deque<T> y;
+    for (std::size_t i = 0; i != n; ++i) {
+        x.push_back(static_cast<T>(i));
+        y.push_front(static_cast<T>(n - 1 - i));}
+    long long hits = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        hits += std::equal(x.begin(), x.end(), y.begin());
+    const double std_equal_ms = elapsed_ms(start) / reps;
+    start = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        hits += (x == y);
+    const double equal_ms = elapsed_ms(start) / reps;
+    start = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        hits += std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+    const double std_less_ms = elapsed_ms(start) / reps;
+    start = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        hits += (x < y);
+    const double less_ms = elapsed_ms(start) / reps;
+    std::size_t h = 0;
+    start = bench_clock::now();
+    for (int r = 0; r != reps; ++r)
+        h += std::hash< my_deque<T> >()(x);
+    const double hash_ms = elapsed_ms(start) / reps;
+    std::cout << std::setw(10) << type
+              << std::setw(14) << std_equal_ms
+              << std::setw(14) << equal_ms
+              << std::setw(14) << std_less_ms
+              << std::setw(14) << less_ms
+              << std::setw(14) << hash_ms
+              << std::setw(8)  << hits
+              << std::setw(22) << h << std::endl;}
+
+// -----
+// suite
+// -----
+
+/**
+ * 256 bytes, the size at which deque_block_size drops to 16 elements.
+ */
+struct blob {
+    char data[256];};
+
+template <typename T>
+T make_value (std::size_t i);
+
+template <>
+int make_value<int> (std::size_t i) {
+    return static_cast<int>(i);}
+
+template <>
+double make_value<double> (std::size_t i) {
+    return i * 0.5;}
+
+template <>
+std::string make_value<std::string> (std::size_t i) {
+    return "value-" + std::to_string(i);}
+
+template <>
+blob make_value<blob> (std::size_t i) {
+    blob b;
+    std::memset(b.data, static_cast<int>(i), sizeof(b.data));
+    return b;}
+
+long long digest (int v)                {return v;}
+long long digest (double v)             {return static_cast<long long>(v);}
+long long digest (const std::string& v) {return static_cast<long long>(v.size());}
+long long digest (const blob& v)        {return v.data[0];}
+
+// -----------
+// bench_batch
+// -----------
+
+/**
+ * Consumes n Ts in batches of k: front() and pop_front() k times, then
+ * drain_front(k) into a buffer, and prints the ms of each.
+ */
+template <typename T>
+void bench_batch (const char* type, std::size_t n, std::size_t k) {
+    my_deque<T> x;
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(make_value<T>(i));
+    my_deque<T> y(x);
+    std::vector<T> buffer(k);
+    long long sum = 0;
+    bench_clock::time_point start = bench_clock::now();
+    while (!x.empty()) {
+        const std::size_t m = std::min(k, x.size());
+        for (std::size_t i = 0; i != m; ++i) {
+            buffer[i] = std::move(x.front());
+            x.pop_front();}
+        sum += digest(buffer[0]);}
+    const double loop_ms = elapsed_ms(start);
+    start = bench_clock::now();
+    while (!y.empty()) {
+        const std::size_t m = std::min(k, y.size());
+        y.drain_front(m, buffer.begin());
+        sum += digest(buffer[0]);}
+    const double drain_ms = elapsed_ms(start);
+    std::cout << std::setw(14) << type
+              << std::setw(18) << loop_ms
+              << std::setw(18) << drain_ms
+              << std::setw(20) << sum << std::endl;}
+
+/**
+ * Every checksum ends up here so that no timed loop can be optimized away.
+ */
+volatile long long bench_sink = 0;
+
+/**
+ * std::vector has no push_front/pop_front; the front operations are only
+ * run for containers that do.
+ */
+template <typename C>
+struct has_front : std::true_type {};
+
+template <typename T, typename A>
+struct has_front< std::vector<T, A> > : std::false_type {};
+
+/**
+ * Small sizes are repeated until about a million elements have been
+ * touched, so their per-element time is not just clock resolution.
+ */
+std::size_t repetitions (std::size_t ops) {
+    return std::max<std::size_t>(1, 1000000 / std::max<std::size_t>(1, ops));}
+
+void csv_row (std::ostream& out, const char* container, const char* type, std::size_t n, const char* operation, double ms, double ns_per_element) {
+    out << container << ',' << type << ',' << n << ',' << operation << ',' << ms << ',' << ns_per_element << std::endl;}
+
+/**
+ * One CSV row; f times one repetition of ops element operations and
+ * returns milliseconds.
+ */
+template <typename F>
+void measure (std::ostream& out, const char* container, const char* type, std::size_t n, const char* operation, std::size_t ops, F f) {
+    const std::size_t reps = repetitions(ops);
+    double ms = 0;
+    for (std::size_t r = 0; r != reps; ++r)
+        ms += f();
+    csv_row(out, container, type, n, operation, ms / reps, ms * 1e6 / (reps * ops));}
+
+template <typename C>
+C filled (std::size_t n) {
+    C x;
+    for (std::size_t i = 0; i != n; ++i)
+        x.push_back(make_value<typename C::value_type>(i));
+    return x;}
+
+template <typename C>
+void bench_front (std::ostream&, const char*, const char*, std::size_t, std::false_type) {}
+
+template <typename C>
+void bench_front (std::ostream& out, const char* container, const char* type, std::size_t n, std::true_type) {
+    typedef typename C::value_type T;
+    measure(out, container, type, n, "push_front", n, [n] () {
+        bench_clock::time_point start = bench_clock::now();
+        C x;
+        for (std::size_t i = 0; i != n; ++i)
+            x.push_front(make_value<T>(i));
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + x.size();
+        return ms;});
+    measure(out, container, type, n, "pop_front", n, [n] () {
+        C x = filled<C>(n);
+        bench_clock::time_point start = bench_clock::now();
+        while (!x.empty())
+            x.pop_front();
+        return elapsed_ms(start);});
+    measure(out, container, type, n, "fifo", n, [n] () {
+        C x = filled<C>(n);
+        bench_clock::time_point start = bench_clock::now();
+        for (std::size_t i = 0; i != n; ++i) {
+            x.push_back(make_value<T>(i));
+            x.pop_front();}
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + digest(x.front());
+        return ms;});}
+
+/**
+ * Runs every operation on a C of n elements.
+ */
+template <typename C>
+void bench_container (std::ostream& out, const char* container, const char* type, std::size_t n) {
+    typedef typename C::value_type T;
+    measure(out, container, type, n, "push_back", n, [n] () {
+        bench_clock::time_point start = bench_clock::now();
+        C x;
+        for (std::size_t i = 0; i != n; ++i)
+            x.push_back(make_value<T>(i));
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + x.size();
+        return ms;});
+    measure(out, container, type, n, "pop_back", n, [n] () {
+        C x = filled<C>(n);
+        bench_clock::time_point start = bench_clock::now();
+        while (!x.empty())
+            x.pop_back();
+        return elapsed_ms(start);});
+    bench_front<C>(out, container, type, n, has_front<C>());
+
+    C x = filled<C>(n);
+    measure(out, container, type, n, "iterate", n, [&x] () {
+        bench_clock::time_point start = bench_clock::now();
+        long long sum = 0;
+        for (const T& v : x)
+            sum += digest(v);
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + sum;
+        return ms;});
+    measure(out, container, type, n, "iterate_random", n, [&x, n] () {
+        bench_clock::time_point start = bench_clock::now();
+        long long sum = 0;
+        unsigned long long j = 1;
+        for (std::size_t i = 0; i != n; ++i) {
+            j = j * 6364136223846793005ULL + 1442695040888963407ULL;
+            sum += digest(*(x.begin() + (j >> 33) % n));}
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + sum;
+        return ms;});
+    measure(out, container, type, n, "index", n, [&x, n] () {
+        bench_clock::time_point start = bench_clock::now();
+        long long sum = 0;
+        for (std::size_t i = 0; i != n; ++i)
+            sum += digest(x[i]);
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + sum;
+        return ms;});
+
+    // each middle insert/erase moves about n/2 elements, so do fewer of them as n grows
+    // and repeat by elements moved; every repetition erases what it inserted
+    const std::size_t k    = std::max<std::size_t>(1, std::min<std::size_t>(n, 10000000 / n));
+    const std::size_t reps = repetitions(k * (n / 2 + 1));
+    const T v = make_value<T>(7);
+    double insert_ms = 0;
+    double erase_ms  = 0;
+    for (std::size_t r = 0; r != reps; ++r) {
+        bench_clock::time_point start = bench_clock::now();
+        for (std::size_t i = 0; i != k; ++i)
+            x.insert(x.begin() + x.size() / 2, v);
+        insert_ms += elapsed_ms(start);
+        start = bench_clock::now();
+        for (std::size_t i = 0; i != k; ++i)
+            x.erase(x.begin() + x.size() / 2);
+        erase_ms += elapsed_ms(start);}
+    csv_row(out, container, type, n, "insert_middle", insert_ms / reps, insert_ms * 1e6 / (reps * k));
+    csv_row(out, container, type, n, "erase_middle",  erase_ms  / reps, erase_ms  * 1e6 / (reps * k));
+
+    measure(out, container, type, n, "copy", n, [&x] () {
+        bench_clock::time_point start = bench_clock::now();
+        C y(x);
+        const double ms = elapsed_ms(start);
+        bench_sink = bench_sink + y.size();
+        return ms;});
+    measure(out, container, type, n, "clear", n, [n] () {
+        C x = filled<C>(n);
+        bench_clock::time_point start = bench_clock::now();
+        x.clear();
+        return elapsed_ms(start);});}
+
+template <typename T>
+void bench_type (std::ostream& out, const char* type, std::size_t max_n) {
+    // keep the largest containers of the larger types within about 1 GB
+    const std::size_t budget = std::size_t(1) << 30;
+    for (std::size_t n = 10; (n <= max_n) && (n <= budget / sizeof(T)); n *= 10) {
+        bench_container< my_deque<T>    >(out, "my_deque",    type, n);
+        bench_container< std::deque<T>  >(out, "std::deque",  type, n);
+        bench_container< std::vector<T> >(out, "std::vector", type, n);}}
+
+/**
+ * CSV with one row per container, element type, size and operation.
+ */
+void bench_suite (std::ostream& out, std::size_t max_n) {
+    out << "container,type,size,operation,ms,ns_per_element" << std::endl;
+    bench_type<int>        (out, "int",         max_n);
+    bench_type<double>     (out, "double",      max_n);
+    bench_type<std::string>(out, "std::string", max_n);
+    bench_type<blob>       (out, "blob256",     max_n);}
+
+// ----
+// main
+// ----
+
+int main (int argc, char* argv[]) {
+    if ((argc > 1) && (std::strcmp(argv[1], "--csv") == 0)) {
+        bench_suite(std::cout, (argc > 2) ? std::strtoull(argv[2], 0, 10) : 1000000);
+        return 0;}
+
+    const std::size_t n = 10000000;
+    std::cout << "my_deque<int> push_back/iterate, n = " << n << std::endl;
+    std::cout << std::setw(10) << "block"
+              << std::setw(10) << "elements"
+              << std::setw(14) << "push (ms)"
+              << std::setw(14) << "iterate (ms)"
+              << std::setw(20) << "checksum" << std::endl;
+    bench_block_size<10>  ("10",      n);
+    bench_block_size<64>  ("64",      n);
+    bench_block_size<128> ("512 B",   n);
+    bench_block_size<1024>("4 KB",    n);
+    bench_block_size<4096>("16 KB",   n);
+    bench_block_size<deque_block_size<int>::value>("default", n);
+
+    std::cout << std::endl << "producer/consumer hand-off, n = " << n << std::endl;
+    std::cout << std::setw(24) << "queue" << std::setw(14) << "time (ms)" << std::setw(14) << "throughput" << std::endl;
+    bench_spsc(n);
+
+    std::cout << std::endl << "many producers/many consumers, n = " << n / 5 << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(20) << "concurrent (ms)" << std::setw(20) << "one mutex (ms)" << std::endl;
+    bench_contention(n / 5);
+
+    std::cout << std::endl << "parallel algorithms over my_deque<int>, n = " << n << std::endl;
+    std::cout << std::setw(10) << "threads"
+              << std::setw(14) << "for_each"
+              << std::setw(14) << "transform"
+              << std::setw(14) << "reduce"
+              << std::setw(14) << "sort"
+              << std::setw(20) << "checksum" << std::endl;
+    bench_parallel(n);
+
+    std::cout << std::endl << "fork/join fib(36) on work_stealing_deque" << std::endl;
+    std::cout << std::setw(10) << "workers" << std::setw(14) << "time (ms)" << std::setw(11) << "speedup" << std::setw(14) << "result" << std::endl;
+    bench_fib(36);
+
+    std::cout << std::endl << "request-scoped my_deque<int>s, " << n / 1000 << " requests of 1000 jobs" << std::endl;
+    std::cout << std::setw(24) << "allocator" << std::setw(14) << "time (ms)" << std::setw(14) << "heap calls" << std::setw(20) << "checksum" << std::endl;
+    bench_arena(n / 1000, 1000);
+
+    std::cout << std::endl << "push latency (ns) keeping the last 4096 samples, n = " << n / 5 << std::endl;
+    latency_header();
+    bench_ring(n / 5, 4096);
+
+    std::cout << std::endl << "push latency (ns) into a fresh deque, n = " << n / 5 << std::endl;
+    latency_header();
+    bench_reserve(n / 5);
+
+    std::cout << std::endl << "RSS (KB) around a spike of " << 2 * n << " ints drained to 100" << std::endl;
+    std::cout << std::setw(24) << "shrink threshold" << std::setw(12) << "before" << std::setw(12) << "peak" << std::setw(12) << "drained" << std::setw(12) << "trimmed" << std::setw(14) << "drain (ms)" << std::endl;
+    bench_rss("1/4 of capacity", 4, 2 * n);
+    bench_rss("off", 0, 2 * n);
+
+    std::cout << std::endl << "checkpoint my_deque<int> to memory and back, n = " << n << std::endl;
+    std::cout << std::setw(24) << "path" << std::setw(14) << "save (ms)" << std::setw(14) << "load (ms)" << std::setw(10) << "equal" << std::endl;
+    bench_io(n);
+
+    std::cout << std::endl << "sequential push_back then pop_front, n = " << 2 * n << std::endl;
+    std::cout << std::setw(24) << "queue" << std::setw(14) << "push (M/s)" << std::setw(14) << "pop (M/s)" << std::setw(16) << "RSS added (KB)" << std::setw(20) << "checksum" << std::endl;
+    bench_mapped(2 * n);
+
+    std::cout << std::endl << "comparing two equal, misaligned deques (ms per pass), n = " << n << std::endl;
+    std::cout << std::setw(10) << "type"
+              << std::setw(14) << "std::equal"
+              << std::setw(14) << "=="
+              << std::setw(14) << "std::lex"
+              << std::setw(14) << "<"
+              << std::setw(14) << "hash"
+              << std::setw(8)  << "hits"
+              << std::setw(22) << "hash value" << std::endl;
+    bench_compare<int>("int", n, 10);
+    bench_compare<double>("double", n, 10);
+
+    std::cout << std::endl << "consuming my_deque in batches of 64, n = " << n << std::endl;
+    std::cout << std::setw(14) << "type" << std::setw(18) << "pop_front (ms)" << std::setw(18) << "drain_front (ms)" << std::setw(20) << "checksum" << std::endl;
+    bench_batch<int>("int", n, 64);
+    bench_batch<std::string>("std::string", n, 64);
+    return 0;}
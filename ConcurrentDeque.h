@@ -0,0 +1,414 @@
+// --------------------------------
+// projects/deque/ConcurrentDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// --------------------------------
+
+#ifndef ConcurrentDeque_h
+#define ConcurrentDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // max, min
+#include <atomic>    // atomic, memory_order
+#include <cassert>   // assert
+#include <cstddef>   // size_t
+#include <memory>    // allocator, allocator_traits
+#include <mutex>     // lock_guard, mutex
+#include <new>       // placement new
+#include <utility>   // forward, move
+
+#include "Deque.h"
+
+// ----------------
+// concurrent_deque
+// ----------------
+
+/**
+ * Multi-producer/multi-consumer deque over the same block map as my_deque.
+ * Front operations take only the front lock and back operations only the
+ * back lock, so pushes at one end run alongside pops at the other.
+ *
+ * _b is only touched under the front lock and _e only under the back lock.
+ * A push publishes its element by incrementing the atomic size; a pop
+ * first reserves an element by decrementing it, which is what stops the
+ * two ends from taking the same last element.
+ *
+ * Map slots are atomic because when the deque is (nearly) empty both ends
+ * can install a block in the same slot. Growing the map moves both
+ * indices, so it takes both locks, always front before back.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t B = deque_block_size<T>::value >
+class concurrent_deque {
+    static_assert(B > 0, "concurrent_deque block size must be positive");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef A                                        allocator_type;
+        typedef typename allocator_type::value_type      value_type;
+        typedef typename allocator_type::size_type       size_type;
+        typedef typename allocator_type::pointer         pointer;
+        typedef typename allocator_type::reference       reference;
+        typedef typename allocator_type::const_reference const_reference;
+
+    private:
+        typedef std::atomic<pointer> slot_type;
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<slot_type> map_alloc_type;
+
+        /**
+         * Keeps the two ends' fields on separate cache lines.
+         */
+        static const std::size_t cache_line = 64;
+
+        static const size_type initial_nodes = 8;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        allocator_type _a;
+        map_alloc_type _o;
+        slot_type*     _map;
+        size_type      _nodes;
+        std::atomic<pointer> _spare;
+
+        alignas(cache_line) std::mutex _front_lock;
+        size_type _b;
+
+        alignas(cache_line) std::mutex _back_lock;
+        size_type _e;
+
+        alignas(cache_line) std::atomic<size_type> _size;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_b <= _e) && (_e <= _nodes * B);}
+
+        // ------
+        // blocks
+        // ------
+
+        /**
+         * The spare block if there is one, a new block otherwise.
+         */
+        pointer allocate_block () {
+            pointer p = _spare.exchange(0, std::memory_order_acq_rel);
+            return (p != 0) ? p : _a.allocate(B);}
+
+        /**
+         * Keeps p as the spare block and frees the one it replaces.
+         */
+        void recycle_block (pointer p) {
+            p = _spare.exchange(p, std::memory_order_acq_rel);
+            if (p != 0)
+                _a.deallocate(p, B);}
+
+        /**
+         * Empties map slot n.
+         */
+        void release_block (size_type n) {
+            pointer p = _map[n].exchange(0, std::memory_order_acq_rel);
+            if (p != 0)
+                recycle_block(p);}
+
+        /**
+         * Storage for absolute index i, installing a block in its slot if
+         * the slot is empty. Whoever loses the race recycles their block.
+         */
+        pointer storage (size_type i) {
+            slot_type& s = _map[i / B];
+            pointer p = s.load(std::memory_order_acquire);
+            if (p == 0) {
+                pointer q = allocate_block();
+                if (s.compare_exchange_strong(p, q, std::memory_order_acq_rel, std::memory_order_acquire))
+                    p = q;
+                else
+                    recycle_block(q);}
+            return p + i % B;}
+
+        /**
+         * The element at absolute index i, which must be live.
+         */
+        pointer element (size_type i) const {
+            return _map[i / B].load(std::memory_order_acquire) + i % B;}
+
+        // -------
+        // reserve
+        // -------
+
+        /**
+         * Takes up to n published elements away from the other pops and
+         * returns how many it got.
+         */
+        size_type reserve (size_type n) {
+            size_type s = _size.load(std::memory_order_acquire);
+            size_type k;
+            do {
+                k = std::min(n, s);
+                if (k == 0)
+                    return 0;}
+            while (!_size.compare_exchange_weak(s, s - k, std::memory_order_acq_rel, std::memory_order_acquire));
+            return k;}
+
+        // ---
+        // map
+        // ---
+
+        /**
+         * Makes room for front_n more elements before _b and back_n more
+         * from _e on, unless another thread already has. Takes both locks,
+         * so the caller must hold neither.
+         */
+        void grow (size_type front_n, size_type back_n) {
+            std::lock_guard<std::mutex> front(_front_lock);
+            std::lock_guard<std::mutex> back(_back_lock);
+            if ((_b >= front_n) && (_e + back_n <= _nodes * B))
+                return;
+            const size_type lo    = std::min(_b / B, _nodes);
+            const size_type hi    = std::min(_e / B + 1, _nodes);
+            const size_type live  = hi - lo;
+            const size_type extra = (std::max(front_n, back_n) + B - 1) / B + 1;
+            const size_type nodes = live + 2 * extra + std::max(live, initial_nodes);
+            const size_type first = (nodes - live) / 2;
+
+            slot_type* m = _o.allocate(nodes);
+            for (size_type i = 0; i != nodes; ++i)
+                ::new (static_cast<void*>(m + i)) slot_type(0);
+            for (size_type i = 0; i != _nodes; ++i) {
+                pointer p = _map[i].load(std::memory_order_relaxed);
+                if ((i >= lo) && (i < hi))
+                    m[first + i - lo].store(p, std::memory_order_relaxed);
+                else if (p != 0)
+                    recycle_block(p);}
+            _o.deallocate(_map, _nodes);
+
+            const size_type n = _e - _b;
+            _map   = m;
+            _nodes = nodes;
+            _b     = first * B + (_b - lo * B);
+            _e     = _b + n;
+            assert(valid());}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * <your documentation>
+         */
+        explicit concurrent_deque (const allocator_type& a = allocator_type()) :
+                _a     (a),
+                _o     (a),
+                _map   (0),
+                _nodes (initial_nodes),
+                _spare (0),
+                _b     (initial_nodes / 2 * B),
+                _e     (initial_nodes / 2 * B),
+                _size  (0) {
+            _map = _o.allocate(_nodes);
+            for (size_type i = 0; i != _nodes; ++i)
+                ::new (static_cast<void*>(_map + i)) slot_type(0);
+            assert(valid());}
+
+        concurrent_deque (const concurrent_deque&) = delete;
+        concurrent_deque& operator = (const concurrent_deque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * No other thread may be using the deque.
+         */
+        ~concurrent_deque () {
+            for (size_type i = _b; i != _e; ++i)
+                std::allocator_traits<allocator_type>::destroy(_a, element(i));
+            for (size_type i = 0; i != _nodes; ++i)
+                release_block(i);
+            pointer p = _spare.load(std::memory_order_relaxed);
+            if (p != 0)
+                _a.deallocate(p, B);
+            _o.deallocate(_map, _nodes);}
+
+        // ----
+        // back
+        // ----
+
+        /**
+         * <your documentation>
+         */
+        template <typename... Args>
+        void emplace_back (Args&&... args) {
+            for (;;) {
+                {
+                    std::lock_guard<std::mutex> lock(_back_lock);
+                    if (_e / B < _nodes) {
+                        std::allocator_traits<allocator_type>::construct(_a, storage(_e), std::forward<Args>(args)...);
+                        ++_e;
+                        _size.fetch_add(1, std::memory_order_release);
+                        return;}
+                }
+                grow(0, 1);}}
+
+        /**
+         * <your documentation>
+         */
+        void push_back (const_reference v) {
+            emplace_back(v);}
+
+        /**
+         * <your documentation>
+         */
+        void push_back (value_type&& v) {
+            emplace_back(std::move(v));}
+
+        /**
+         * Appends n elements copied from first under one acquisition of the
+         * back lock. They become visible to pops together. If a copy throws,
+         * none of them are added.
+         */
+        template <typename II>
+        void push_back_n (II first, size_type n) {
+            if (n == 0)
+                return;
+            for (;;) {
+                {
+                    std::lock_guard<std::mutex> lock(_back_lock);
+                    if ((_e + n - 1) / B < _nodes) {
+                        size_type i = 0;
+                        try {
+                            for (; i != n; ++i, ++first)
+                                std::allocator_traits<allocator_type>::construct(_a, storage(_e + i), *first);}
+                        catch (...) {
+                            while (i != 0)
+                                std::allocator_traits<allocator_type>::destroy(_a, element(_e + --i));
+                            throw;}
+                        _e += n;
+                        _size.fetch_add(n, std::memory_order_release);
+                        return;}
+                }
+                grow(0, n);}}
+
+        /**
+         * Moves the back element into x and removes it.
+         * Returns false, leaving x alone, when the deque is empty.
+         * If the move throws, the element stays in the deque.
+         */
+        bool try_pop_back (value_type& x) {
+            std::lock_guard<std::mutex> lock(_back_lock);
+            if (reserve(1) == 0)
+                return false;
+            pointer p = element(_e - 1);
+            try {
+                x = std::move(*p);}
+            catch (...) {
+                _size.fetch_add(1, std::memory_order_release);
+                throw;}
+            std::allocator_traits<allocator_type>::destroy(_a, p);
+            --_e;
+            if (_e % B == 0)
+                release_block(_e / B);
+            return true;}
+
+        // -----
+        // front
+        // -----
+
+        /**
+         * <your documentation>
+         */
+        template <typename... Args>
+        void emplace_front (Args&&... args) {
+            for (;;) {
+                {
+                    std::lock_guard<std::mutex> lock(_front_lock);
+                    if (_b != 0) {
+                        std::allocator_traits<allocator_type>::construct(_a, storage(_b - 1), std::forward<Args>(args)...);
+                        --_b;
+                        _size.fetch_add(1, std::memory_order_release);
+                        return;}
+                }
+                grow(1, 0);}}
+
+        /**
+         * <your documentation>
+         */
+        void push_front (const_reference v) {
+            emplace_front(v);}
+
+        /**
+         * <your documentation>
+         */
+        void push_front (value_type&& v) {
+            emplace_front(std::move(v));}
+
+        /**
+         * Moves the front element into x and removes it.
+         * Returns false, leaving x alone, when the deque is empty.
+         */
+        bool try_pop_front (value_type& x) {
+            std::lock_guard<std::mutex> lock(_front_lock);
+            if (reserve(1) == 0)
+                return false;
+            pointer p = element(_b);
+            try {
+                x = std::move(*p);}
+            catch (...) {
+                _size.fetch_add(1, std::memory_order_release);
+                throw;}
+            std::allocator_traits<allocator_type>::destroy(_a, p);
+            if (++_b % B == 0)
+                release_block(_b / B - 1);
+            return true;}
+
+        /**
+         * Moves up to n elements from the front to out under one acquisition
+         * of the front lock and returns how many were moved.
+         */
+        template <typename OI>
+        size_type pop_front_n (OI out, size_type n) {
+            std::lock_guard<std::mutex> lock(_front_lock);
+            const size_type k = reserve(n);
+            for (size_type i = 0; i != k; ++i, ++out) {
+                pointer p = element(_b);
+                try {
+                    *out = std::move(*p);}
+                catch (...) {
+                    _size.fetch_add(k - i, std::memory_order_release);
+                    throw;}
+                std::allocator_traits<allocator_type>::destroy(_a, p);
+                if (++_b % B == 0)
+                    release_block(_b / B - 1);}
+            return k;}
+
+        // ---------
+        // observers
+        // ---------
+
+        /**
+         * Only a snapshot while other threads are running.
+         */
+        size_type size () const {
+            return _size.load(std::memory_order_acquire);}
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return size() == 0;}};
+
+template <typename T, typename A, std::size_t B>
+const typename concurrent_deque<T, A, B>::size_type concurrent_deque<T, A, B>::initial_nodes;
+
+#endif // ConcurrentDeque_h
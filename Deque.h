@@ -11,48 +11,139 @@
 // includes
 // --------
 
-#include <algorithm> // copy, equal, lexicographical_compare, max, swap
+#include <algorithm> // copy, max, min, swap
 #include <cassert>   // assert
-#include <iterator>  // iterator, bidirectional_iterator_tag
-#include <memory>    // allocator
+#include <cstddef>   // size_t
+#include <cstdint>   // uint32_t, uint64_t
+#include <cstring>   // memcmp, memcpy, memmove
+#include <functional> // hash
+#include <initializer_list> // initializer_list
+#include <ios>       // ios_base
+#include <istream>   // istream
+#include <iterator>  // random_access_iterator_tag
+#include <memory>    // allocator, allocator_traits
+#include <numeric>   // accumulate
+#include <ostream>   // ostream
 #include <stdexcept> // out_of_range
-#include <utility>   // !=, <=, >, >=
+#include <string>    // string
+#include <type_traits> // enable_if, integral_constant, is_integral, is_trivially_copyable
+#include <utility>   // !=, <=, >, >=, forward, move
 
+#if __cplusplus >= 201703L
+#include <memory_resource> // polymorphic_allocator
+#endif
 
 
 // -----
 // using
 // -----
-const int INNER_SIZE  = 10;
+
 using std::rel_ops::operator!=;
 using std::rel_ops::operator<=;
 using std::rel_ops::operator>;
 using std::rel_ops::operator>=;
 using namespace std;
 
+// -------------------
+// construction traits
+// -------------------
+
+/**
+ * True when A constructs and destroys exactly like placement new and ~T,
+ * which is what lets trivial types skip it.
+ */
+template <typename A>
+struct uses_default_construct :
+        std::is_same<A, std::allocator<typename A::value_type> > {};
+
+#if __cplusplus >= 201703L
+/**
+ * polymorphic_allocator only differs from placement new for types that
+ * take an allocator themselves.
+ */
+template <typename T>
+struct uses_default_construct< std::pmr::polymorphic_allocator<T> > :
+        std::integral_constant<bool, !std::uses_allocator<T, std::pmr::polymorphic_allocator<T> >::value> {};
+#endif
+
+/**
+ * Destroying a T through A does nothing.
+ */
+template <typename A, typename T>
+struct trivially_destroyed :
+        std::integral_constant<bool, uses_default_construct<A>::value && std::is_trivially_destructible<T>::value> {};
+
+/**
+ * Copy-constructing a T through A is a plain byte copy.
+ */
+template <typename A, typename T>
+struct trivially_copied :
+        std::integral_constant<bool, uses_default_construct<A>::value && std::is_trivially_copyable<T>::value> {};
+
 // -------
 // destroy
 // -------
 
 template <typename A, typename BI>
-BI destroy (A& a, BI b, BI e) {
+BI destroy (A&, BI b, BI, std::true_type) {
+    return b;
+}
+
+template <typename A, typename BI>
+BI destroy (A& a, BI b, BI e, std::false_type) {
     while (b != e) {
         --e;
-        a.destroy(&*e);
+        std::allocator_traits<A>::destroy(a, &*e);
     }
     return b;
 }
 
+template <typename A, typename BI>
+BI destroy (A& a, BI b, BI e) {
+    return destroy(a, b, e, trivially_destroyed<A, typename std::iterator_traits<BI>::value_type>());
+}
+
 // ------------------
 // uninitialized_copy
 // ------------------
 
+/**
+ * Contiguous source and destination of the same type: one memmove.
+ */
+template <typename T>
+T* trivial_copy (const T* b, const T* e, T* x) {
+    const std::size_t n = e - b;
+    if (n != 0)
+        std::memmove(x, b, n * sizeof(T));
+    return x + n;
+}
+
+template <typename T>
+T* trivial_copy (T* b, T* e, T* x) {
+    return trivial_copy(static_cast<const T*>(b), static_cast<const T*>(e), x);
+}
+
+/**
+ * Any other source: plain assignment, which cannot throw and needs no rollback.
+ */
+template <typename II, typename BI>
+BI trivial_copy (II b, II e, BI x) {
+    for (; b != e; ++b, ++x)
+        *x = *b;
+    return x;
+}
+
 template <typename A, typename II, typename BI>
-BI uninitialized_copy (A& a, II b, II e, BI x) {
+BI uninitialized_copy (A&, II b, II e, BI x, std::true_type) {
+    return trivial_copy(b, e, x);
+}
+
+template <typename A, typename II, typename BI>
+BI uninitialized_copy (A& a, II b, II e, BI x, std::false_type) {
     BI p = x;
     try {
         while (b != e) {
-            a.construct(&*x, *b);
+            std::allocator_traits<A>::construct(a, &*x, *b);
             ++b;
             ++x;
         }
@@ -64,18 +155,27 @@ BI uninitialized_copy (A& a, II b, II e, BI x) {
     return x;
 }
 
-
+template <typename A, typename II, typename BI>
+BI uninitialized_copy (A& a, II b, II e, BI x) {
+    return uninitialized_copy(a, b, e, x, trivially_copied<A, typename std::iterator_traits<BI>::value_type>());
+}
 
 // ------------------
 // uninitialized_fill
 // ------------------
 
 template <typename A, typename BI, typename U>
-BI uninitialized_fill (A& a, BI b, BI e, const U& v) {
+BI uninitialized_fill (A&, BI b, BI e, const U& v, std::true_type) {
+    std::fill(b, e, v);
+    return e;
+}
+
+template <typename A, typename BI, typename U>
+BI uninitialized_fill (A& a, BI b, BI e, const U& v, std::false_type) {
     BI p = b;
     try {
         while (b != e) {
-            a.construct(&*b, v);
+            std::allocator_traits<A>::construct(a, &*b, v);
             ++b;
         }
     }
@@ -86,363 +186,896 @@ BI uninitialized_fill (A& a, BI b, BI e, const U& v) {
     return e;
 }
 
-// -------
-// my_deque
-// -------
+template <typename A, typename BI, typename U>
+BI uninitialized_fill (A& a, BI b, BI e, const U& v) {
+    return uninitialized_fill(a, b, e, v, trivially_copied<A, typename std::iterator_traits<BI>::value_type>());
+}
 
-template < typename T, typename A = std::allocator<T> >
-class my_deque {
-    public:        
+// ----------------
+// deque_block_size
+// ----------------
+
+/**
+ * Number of elements in each block of a my_deque<T>.
+ * Blocks are about 4 KB, with a floor of 16 elements for large T.
+ * Specialize this for a type to change the default block size.
+ */
+template <typename T>
+struct deque_block_size {
+    static const std::size_t bytes = 4096;
+    static const std::size_t value = (sizeof(T) < bytes / 16) ? (bytes / sizeof(T)) : 16;
+};
+
+// -----------------
+// my_deque_iterator
+// -----------------
+
+/**
+ * Random-access iterator over the blocks of a my_deque.
+ * Caches the current block's [first, last) and its map node, so that
+ * ++, -- and * only touch the map when crossing a block boundary.
+ * R and P are T& and T* for iterator, const T& and const T* for const_iterator.
+ */
+template <typename T, typename R, typename P, std::size_t B>
+class my_deque_iterator {
+    template <typename, typename, std::size_t, std::size_t>
+    friend class my_deque;
+
+    template <typename, typename, typename, std::size_t>
+    friend class my_deque_iterator;
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T                               value_type;
+        typedef std::ptrdiff_t                  difference_type;
+        typedef P                               pointer;
+        typedef R                               reference;
+
+        typedef T**                             map_pointer;
+
+        typedef my_deque_iterator<T, T&, T*, B>             iterator;
+        typedef my_deque_iterator<T, const T&, const T*, B> const_iterator;
+
+    public:
+        /**
+         * Two iterators are equal when they point at the same element.
+         */
+        friend bool operator == (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return lhs._cur == rhs._cur;}
 
-        typedef A                                        allocator_type;
-        typedef typename allocator_type::value_type      value_type;
-        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<T*> outer_alloc_type;
+        /**
+         * <your documentation>
+         */
+        friend bool operator != (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return !(lhs == rhs);}
 
-        typedef typename allocator_type::size_type       size_type;
-        typedef typename allocator_type::difference_type difference_type;
-        typedef typename outer_alloc_type::size_type     outer_size_type;
-        typedef typename outer_alloc_type::difference_type outer_difference_type;
+        /**
+         * Orders by map node first, then by position within the block.
+         */
+        friend bool operator < (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return (lhs._node == rhs._node) ? (lhs._cur < rhs._cur) : (lhs._node < rhs._node);}
 
-        typedef typename allocator_type::pointer         pointer;
-        typedef typename allocator_type::const_pointer   const_pointer;
-        typedef typename outer_alloc_type::pointer       outer_pointer;
+        /**
+         * <your documentation>
+         */
+        friend bool operator > (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return rhs < lhs;}
 
-        typedef typename allocator_type::reference       reference;
-        typedef typename allocator_type::const_reference const_reference;
+        /**
+         * <your documentation>
+         */
+        friend bool operator <= (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return !(rhs < lhs);}
 
-    public:        
+        /**
+         * <your documentation>
+         */
+        friend bool operator >= (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return !(lhs < rhs);}
 
         /**
          * <your documentation>
          */
-        friend bool operator == (const my_deque& lhs, const my_deque& rhs) {
-            return (lhs.size() == rhs.size()) && std::equal(lhs.begin(), lhs.end(), rhs.begin());        
-        }
-        
+        friend my_deque_iterator operator + (my_deque_iterator lhs, difference_type rhs) {
+            return lhs += rhs;}
 
         /**
          * <your documentation>
          */
-        friend bool operator < (const my_deque& lhs, const my_deque& rhs) {            
-            return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());            
-        }
+        friend my_deque_iterator operator + (difference_type lhs, my_deque_iterator rhs) {
+            return rhs += lhs;}
 
-    private:        
+        /**
+         * <your documentation>
+         */
+        friend my_deque_iterator operator - (my_deque_iterator lhs, difference_type rhs) {
+            return lhs -= rhs;}
 
-        allocator_type _a;
-        outer_alloc_type _o;        
-        T** arr_ptr;
-        size_type _l;        
-        size_type _b;
-        size_type _e;
-        size_type number_of_arrays;
-        bool new_empty_deque;
+        /**
+         * Distance in elements: whole blocks between the nodes plus the in-block offsets.
+         */
+        friend difference_type operator - (const my_deque_iterator& lhs, const my_deque_iterator& rhs) {
+            return difference_type(B) * (lhs._node - rhs._node)
+                 + (lhs._cur - lhs._first) - (rhs._cur - rhs._first);}
+
+    private:
+        T*          _cur;
+        T*          _first;
+        T*          _last;
+        map_pointer _node;
+
+    private:
+        void set_node (map_pointer new_node) {
+            _node  = new_node;
+            _first = *new_node;
+            _last  = (_first == 0) ? _first : _first + B;}
+
+    public:
+        /**
+         * A singular iterator; only an empty my_deque hands these out.
+         */
+        my_deque_iterator () :
+                _cur (0),
+                _first (0),
+                _last (0),
+                _node (0)
+            {}
 
-    private:        
+        /**
+         * Points at cur, which lies in the block *node.
+         * Only the end position may sit on a node whose block is not allocated yet.
+         */
+        my_deque_iterator (T* cur, map_pointer node) :
+                _cur (cur),
+                _first (*node),
+                _last ((*node == 0) ? *node : *node + B),
+                _node (node)
+            {}
 
-        bool valid () const {
-            
-            return true;
-        }
-        void Construct(const allocator_type& a, const outer_alloc_type& o) {
-            _a = a;
-            _o = o;
-            arr_ptr = 0;
-            _b = _e = number_of_arrays = _l = 0;
-            new_empty_deque = true;
-            assert(valid());
-        }
+        /**
+         * Copy, or convert an iterator to a const_iterator.
+         */
+        my_deque_iterator (const iterator& that) :
+                _cur (that._cur),
+                _first (that._first),
+                _last (that._last),
+                _node (that._node)
+            {}
 
-    public:        
+        // Default destructor and copy assignment.
+        // ~my_deque_iterator ();
+        // my_deque_iterator& operator = (const my_deque_iterator&);
 
-        class iterator {
-            public:
-                // --------
-                // typedefs
-                // --------
+        /**
+         * <your documentation>
+         */
+        reference operator * () const {
+            return *_cur;}
 
-                typedef std::bidirectional_iterator_tag   iterator_category;
-                typedef typename my_deque::value_type      value_type;
-                typedef typename my_deque::difference_type difference_type;
-                typedef typename my_deque::pointer         pointer;
-                typedef typename my_deque::reference       reference;
+        /**
+         * <your documentation>
+         */
+        pointer operator -> () const {
+            return _cur;}
 
-            public:
+        /**
+         * <your documentation>
+         */
+        reference operator [] (difference_type n) const {
+            return *(*this + n);}
 
-                /**
-                 * <your documentation>
-                 */
-                friend bool operator == (const iterator& lhs, const iterator& rhs) {
-                    if(lhs._deque == rhs._deque){
-                        return lhs.current_location == rhs.current_location;
-                    }
-                    return false;
-                }
+        /**
+         * Bumps the cached pointer; steps to the next node only at the end of a block.
+         */
+        my_deque_iterator& operator ++ () {
+            ++_cur;
+            if (_cur == _last) {
+                set_node(_node + 1);
+                _cur = _first;}
+            return *this;}
 
-                /**
-                 * <your documentation>
-                 */
-                friend bool operator != (const iterator& lhs, const iterator& rhs) {
-                    return !(lhs == rhs);
-                }                
+        /**
+         * <your documentation>
+         */
+        my_deque_iterator operator ++ (int) {
+            my_deque_iterator x = *this;
+            ++(*this);
+            return x;}
 
-                /**
-                 * <your documentation>
-                 */
-                friend iterator operator + (iterator lhs, difference_type rhs) {
-                    return lhs += rhs;
-                }
+        /**
+         * <your documentation>
+         */
+        my_deque_iterator& operator -- () {
+            if (_cur == _first) {
+                set_node(_node - 1);
+                _cur = _last;}
+            --_cur;
+            return *this;}
 
-                /**
-                 * <your documentation>
-                 */
-                friend iterator operator - (iterator lhs, difference_type rhs) {
-                    return lhs -= rhs;
-                }
+        /**
+         * <your documentation>
+         */
+        my_deque_iterator operator -- (int) {
+            my_deque_iterator x = *this;
+            --(*this);
+            return x;}
 
-                friend size_type my_deque::get_current_location(iterator& iter);
+        /**
+         * Stays in the current block when it can, otherwise jumps straight to the target node.
+         */
+        my_deque_iterator& operator += (difference_type d) {
+            const difference_type block  = difference_type(B);
+            const difference_type offset = d + (_cur - _first);
+            if ((offset >= 0) && (offset < block))
+                _cur += d;
+            else {
+                const difference_type node_offset = (offset > 0) ?
+                    offset / block :
+                    -((-offset - 1) / block) - 1;
+                set_node(_node + node_offset);
+                _cur = _first + (offset - node_offset * block);}
+            return *this;}
 
-            private:                
+        /**
+         * <your documentation>
+         */
+        my_deque_iterator& operator -= (difference_type d) {
+            return *this += -d;}
 
-                my_deque* _deque;
-                size_type current_location;
-                bool valid_iterator;
+        // ---------
+        // segmented
+        // ---------
 
-            private:                
+        /**
+         * The map node of the block this iterator is in.
+         */
+        map_pointer segment () const {
+            return _node;}
 
-                bool valid () const {
-                    
-                    return valid_iterator;
-                }
+        /**
+         * The position within the current block.
+         */
+        pointer local () const {
+            return _cur;}
 
-            public:                
+        /**
+         * The first slot of the block at node.
+         */
+        static pointer segment_begin (map_pointer node) {
+            return *node;}
 
-                /**
-                 * <your documentation>
-                 */
-                iterator (my_deque* p, size_type curr) {
-                    _deque = p;
-                    current_location = curr;                    
-                    if(current_location >= p->_b && current_location <= p->_e){
-                        valid_iterator = true;
-                    }                    
-                    else{
-                        valid_iterator = false;
-                    }
-                    assert(valid());
-                }
+        /**
+         * One past the last slot of the block at node.
+         */
+        static pointer segment_end (map_pointer node) {
+            return *node + B;}};
+
+// ----------------
+// for_each_segment
+// ----------------
+
+/**
+ * Calls f(b, e) once for each contiguous run [b, e) of [first, last),
+ * in order. Empty runs are skipped. Returns f.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename F>
+F for_each_segment (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, F f) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    typedef typename iterator::map_pointer map_pointer;
+    if (first.segment() == last.segment()) {
+        if (first.local() != last.local())
+            f(first.local(), last.local());
+        return f;}
+    f(first.local(), iterator::segment_end(first.segment()));
+    for (map_pointer node = first.segment() + 1; node != last.segment(); ++node)
+        f(iterator::segment_begin(node), iterator::segment_end(node));
+    if (iterator::segment_begin(last.segment()) != last.local())
+        f(iterator::segment_begin(last.segment()), last.local());
+    return f;}
+
+// ---------------------
+// for_each_segment_pair
+// ---------------------
+
+/**
+ * Walks n elements from first1 and from first2 in step, calling f(p, q, k)
+ * for each stretch of k elements that is contiguous in both; the two
+ * ranges' block boundaries need not line up. Stops at the first call that
+ * returns false, and returns whether none did.
+ */
+template <typename T, typename R1, typename P1, typename R2, typename P2, std::size_t B, typename F>
+bool for_each_segment_pair (my_deque_iterator<T, R1, P1, B> first1, my_deque_iterator<T, R2, P2, B> first2, std::ptrdiff_t n, F f) {
+    typedef my_deque_iterator<T, R1, P1, B> iterator1;
+    typedef my_deque_iterator<T, R2, P2, B> iterator2;
+    while (n > 0) {
+        const P1 p = first1.local();
+        const P2 q = first2.local();
+        const std::ptrdiff_t k = std::min(n, std::min<std::ptrdiff_t>(
+            iterator1::segment_end(first1.segment()) - p,
+            iterator2::segment_end(first2.segment()) - q));
+        if (!f(p, q, k))
+            return false;
+        n -= k;
+        if (n == 0)
+            break;
+        first1 += k;
+        first2 += k;}
+    return true;}
 
-                // Default copy, destructor, and copy assignment.
-                // iterator (const iterator&);
-                // ~iterator ();
-                // iterator& operator = (const iterator&);
+// ------------------
+// bitwise_comparable
+// ------------------
 
-                /**
-                 * <your documentation>
-                 */
-                reference operator * () const {                                        
+/**
+ * Types whose == is equality of their bytes, so runs of them can be
+ * compared with memcmp. Not floating point: 0.0 == -0.0, and NaN != NaN.
+ */
+template <typename T>
+struct bitwise_comparable :
+        std::integral_constant<bool, std::is_integral<T>::value || std::is_pointer<T>::value> {};
+
+/**
+ * Types whose < is the order of their bytes, so memcmp's sign is the
+ * answer of lexicographical_compare.
+ */
+template <typename T>
+struct bytewise_ordered :
+        std::integral_constant<bool, std::is_integral<T>::value && std::is_unsigned<T>::value && (sizeof(T) == 1)> {};
 
-                    return (*_deque)[current_location - _deque->_b];
-                }                
+// -----
+// equal
+// -----
 
-                /**
-                 * <your documentation>
-                 */
-                pointer operator -> () const {
-                    return &**this;
-                }                
+template <typename P1, typename P2>
+bool equal_run (P1 p, P2 q, std::ptrdiff_t n, std::true_type) {
+    return std::memcmp(p, q, n * sizeof(*p)) == 0;}
+
+template <typename P1, typename P2>
+bool equal_run (P1 p, P2 q, std::ptrdiff_t n, std::false_type) {
+    for (const P1 e = p + n; p != e; ++p, ++q)
+        if (!(*p == *q))
+            return false;
+    return true;}
+
+/**
+ * Block-wise equal: memcmp over each stretch when T allows it, otherwise
+ * a plain pointer loop.
+ */
+template <typename T, typename R1, typename P1, typename R2, typename P2, std::size_t B>
+bool equal (my_deque_iterator<T, R1, P1, B> first1, my_deque_iterator<T, R1, P1, B> last1, my_deque_iterator<T, R2, P2, B> first2) {
+    return for_each_segment_pair(first1, first2, last1 - first1, [] (P1 p, P2 q, std::ptrdiff_t n) {
+        return equal_run(p, q, n, bitwise_comparable<T>());});}
+
+// -----------------------
+// lexicographical_compare
+// -----------------------
+
+/**
+ * Compares n elements at p and q; returns <0, 0 or >0.
+ */
+template <typename P1, typename P2>
+int compare_run (P1 p, P2 q, std::ptrdiff_t n, std::true_type) {
+    return std::memcmp(p, q, n * sizeof(*p));}
+
+template <typename P1, typename P2>
+int compare_run (P1 p, P2 q, std::ptrdiff_t n, std::false_type) {
+    typedef typename std::iterator_traits<P1>::value_type T;
+    if (bitwise_comparable<T>::value && (std::memcmp(p, q, n * sizeof(T)) == 0))
+        return 0;
+    for (const P1 e = p + n; p != e; ++p, ++q) {
+        if (*p < *q)
+            return -1;
+        if (*q < *p)
+            return 1;}
+    return 0;}
+
+/**
+ * Block-wise lexicographical_compare. Stretches of bitwise comparable
+ * elements that are equal are skipped with memcmp; only the stretch with
+ * the first difference is walked with <.
+ */
+template <typename T, typename R1, typename P1, typename R2, typename P2, std::size_t B>
+bool lexicographical_compare (my_deque_iterator<T, R1, P1, B> first1, my_deque_iterator<T, R1, P1, B> last1,
+                              my_deque_iterator<T, R2, P2, B> first2, my_deque_iterator<T, R2, P2, B> last2) {
+    const std::ptrdiff_t n1 = last1 - first1;
+    const std::ptrdiff_t n2 = last2 - first2;
+    int c = 0;
+    for_each_segment_pair(first1, first2, std::min(n1, n2), [&c] (P1 p, P2 q, std::ptrdiff_t n) {
+        c = compare_run(p, q, n, bytewise_ordered<T>());
+        return c == 0;});
+    return (c != 0) ? (c < 0) : (n1 < n2);}
+
+// --------------
+// deque_segments
+// --------------
+
+/**
+ * size elements stored contiguously from data.
+ */
+template <typename P>
+struct deque_span {
+    P           data;
+    std::size_t size;};
+
+/**
+ * The contiguous runs of [first, last), in order and without empty runs,
+ * as a range of deque_spans; for_each_segment as a range, so the runs can
+ * be handed to writev or a vectorized loop. It holds two iterators and is
+ * valid as long as they are.
+ */
+template <typename T, typename R, typename P, std::size_t B>
+class deque_segments {
+    public:
+        typedef my_deque_iterator<T, R, P, B>     deque_iterator;
+        typedef typename deque_iterator::map_pointer map_pointer;
+        typedef deque_span<P>                     value_type;
+        typedef std::size_t                       size_type;
 
-                /**
-                 * <your documentation>
-                 */
-                iterator& operator ++ () {                    
-                    assert(valid());                    
-                    current_location += 1;
-                    return *this;
-                }
+        class iterator {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef deque_span<P>           value_type;
+                typedef std::ptrdiff_t          difference_type;
+                typedef const value_type*       pointer;
+                typedef value_type              reference;
 
-                /**
-                 * <your documentation>
-                 */
-                iterator operator ++ (int) {
-                    iterator x = *this;
-                    ++(*this);
-                    assert(valid());
-                    return x;
-                }                
+            private:
+                const deque_segments* _range;
+                map_pointer           _node;
+
+            public:
+                iterator (const deque_segments* range, map_pointer node) :
+                        _range (range),
+                        _node  (node)
+                    {}
 
                 /**
-                 * <your documentation>
+                 * The run at this node, clipped to [first, last).
                  */
-                iterator& operator -- () {                    
-                    current_location -= 1;
-                    assert(valid());
+                value_type operator * () const {
+                    const P b = (_node == _range->_first.segment()) ? _range->_first.local() : deque_iterator::segment_begin(_node);
+                    const P e = (_node == _range->_last.segment())  ? _range->_last.local()  : deque_iterator::segment_end(_node);
+                    const value_type span = {b, static_cast<std::size_t>(e - b)};
+                    return span;}
+
+                iterator& operator ++ () {
+                    ++_node;
                     return *this;}
 
-                /**
-                 * <your documentation>
-                 */
-                iterator operator -- (int) {
+                iterator operator ++ (int) {
                     iterator x = *this;
-                    --(*this);
-                    assert(valid());
-                    return x;
-                }
-
-                /**
-                 * <your documentation>
-                 */
-                iterator& operator += (difference_type d) {
-                    current_location += d;
-                    assert(valid());
-                    return *this;
-                }
+                    ++*this;
+                    return x;}
 
-                /**
-                 * <your documentation>
-                 */
-                iterator& operator -= (difference_type d) {
-                    current_location -= d;
-                    assert(valid());
-                    return *this;
-                }
+                friend bool operator == (const iterator& lhs, const iterator& rhs) {
+                    return lhs._node == rhs._node;}
 
-                
-            };
+                friend bool operator != (const iterator& lhs, const iterator& rhs) {
+                    return !(lhs == rhs);}};
 
-    public:        
+    private:
+        deque_iterator _first;
+        deque_iterator _last;
+        map_pointer    _end;
 
-        class const_iterator {
-            public:                
+    public:
+        /**
+         * <your documentation>
+         */
+        deque_segments (deque_iterator first, deque_iterator last) :
+                _first (first),
+                _last  (last),
+                _end   (last.segment()) {
+            if ((first.local() != last.local()) && (deque_iterator::segment_begin(last.segment()) != last.local()))
+                ++_end;}
 
-                typedef std::bidirectional_iterator_tag   iterator_category;
-                typedef typename my_deque::value_type      value_type;
-                typedef typename my_deque::difference_type difference_type;
-                typedef typename my_deque::const_pointer   pointer;
-                typedef typename my_deque::const_reference reference;
+        /**
+         * <your documentation>
+         */
+        iterator begin () const {
+            return iterator(this, (_first.local() == _last.local()) ? _end : _first.segment());}
 
-            public:                
-                /**
-                 * <your documentation>
-                 */
-                friend bool operator == (const const_iterator& lhs, const const_iterator& rhs) {
-                    
-                    return lhs.iter == rhs.iter;
-                }
+        /**
+         * <your documentation>
+         */
+        iterator end () const {
+            return iterator(this, _end);}
 
-                /**
-                 * <your documentation>
-                 */
-                friend bool operator != (const const_iterator& lhs, const const_iterator& rhs) {
-                    return !(lhs == rhs);}
-                
+        /**
+         * The number of runs.
+         */
+        size_type size () const {
+            return (_first.local() == _last.local()) ? 0 : _end - _first.segment();}
 
-                /**
-                 * <your documentation>
-                 */
-                friend const_iterator operator + (const_iterator lhs, difference_type rhs) {
-                    return lhs += rhs;}
-                
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return size() == 0;}};
+
+/**
+ * The contiguous runs of [first, last).
+ */
+template <typename T, typename R, typename P, std::size_t B>
+deque_segments<T, R, P, B> segments (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last) {
+    return deque_segments<T, R, P, B>(first, last);}
+
+// ----
+// copy
+// ----
+
+/**
+ * Block-wise copy out of a my_deque; each run is a plain pointer copy.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename OI>
+OI copy (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, OI x) {
+    for_each_segment(first, last, [&x] (P b, P e) {
+        x = std::copy(b, e, x);});
+    return x;}
+
+// ----
+// fill
+// ----
+
+/**
+ * Block-wise fill of a my_deque range.
+ */
+template <typename T, std::size_t B, typename U>
+void fill (my_deque_iterator<T, T&, T*, B> first, my_deque_iterator<T, T&, T*, B> last, const U& v) {
+    for_each_segment(first, last, [&v] (T* b, T* e) {
+        std::fill(b, e, v);});}
 
-                /**
-                 * <your documentation>
-                 */
-                friend const_iterator operator - (const_iterator lhs, difference_type rhs) {
-                    return lhs -= rhs;}
+// --------
+// for_each
+// --------
 
-            private:
-                iterator iter;
+/**
+ * Block-wise for_each; f sees each element in order.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename UF>
+UF for_each (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, UF f) {
+    for_each_segment(first, last, [&f] (P b, P e) {
+        for (; b != e; ++b)
+            f(*b);});
+    return f;}
+
+// ----------
+// accumulate
+// ----------
+
+/**
+ * Block-wise accumulate with a binary operation, folded left to right.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U, typename BF>
+U accumulate (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, U v, BF f) {
+    for_each_segment(first, last, [&v, &f] (P b, P e) {
+        for (; b != e; ++b)
+            v = f(v, *b);});
+    return v;}
+
+/**
+ * Block-wise accumulate with +.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U>
+U accumulate (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, U v) {
+    for_each_segment(first, last, [&v] (P b, P e) {
+        for (; b != e; ++b)
+            v = v + *b;});
+    return v;}
+
+// ----
+// find
+// ----
+
+/**
+ * Block-wise find; returns last if no element equals v.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U>
+my_deque_iterator<T, R, P, B> find (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, const U& v) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    while (first.segment() != last.segment()) {
+        P e = iterator::segment_end(first.segment());
+        P p = std::find(first.local(), e, v);
+        if (p != e)
+            return iterator(const_cast<T*>(p), first.segment());
+        first += e - first.local();}
+    P p = std::find(first.local(), last.local(), v);
+    return (p == last.local()) ? last : iterator(const_cast<T*>(p), first.segment());}
 
-            private:                
+// -----
+// count
+// -----
 
-                bool valid () const {
-                    // <your code>
-                    return true;
-                }
+/**
+ * Block-wise count of the elements equal to v.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U>
+typename my_deque_iterator<T, R, P, B>::difference_type count (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, const U& v) {
+    typename my_deque_iterator<T, R, P, B>::difference_type n = 0;
+    for_each_segment(first, last, [&n, &v] (P b, P e) {
+        n += std::count(b, e, v);});
+    return n;}
+
+// -----------
+// deque_stats
+// -----------
+
+#ifdef DEQUE_STATS
+/**
+ * Snapshot of a my_deque's memory, from my_deque::stats(). Compiled in,
+ * together with the counters behind it, only when DEQUE_STATS is defined.
+ */
+struct deque_stats {
+    std::size_t size;              // live elements
+    std::size_t blocks;            // blocks in the map
+    std::size_t idle_blocks;       // blocks in the map that hold no live element
+    std::size_t spare_blocks;      // emptied blocks kept for reuse
+    std::size_t map_slots;         // number_of_arrays
+    std::size_t capacity;          // _l, element slots the map can address
+    std::size_t front_slack;       // slots before the first element
+    std::size_t back_slack;        // slots after the last element
+    std::size_t bytes_allocated;   // blocks, spares and the map
+    std::size_t map_reallocations; // times a new map was allocated
+    std::size_t high_water;        // largest size reached
+};
+#endif
+
+// ------------
+// deque_header
+// ------------
+
+/**
+ * What my_deque::save writes before the elements. Fields are in the
+ * machine's byte order, so files are meant to be read back on the same
+ * kind of machine.
+ */
+struct deque_header {
+    enum {bytes = 1, codec = 2};
+
+    char          magic[4];     // "MYDQ"
+    std::uint32_t version;      // 1
+    std::uint32_t element_size; // sizeof(T)
+    std::uint32_t encoding;     // bytes or codec
+    std::uint64_t size;         // number of elements
+};
+
+// -----------
+// deque_codec
+// -----------
+
+/**
+ * How my_deque::save and load write an element that is not trivially
+ * copyable: write(out, v) and T read(in), reporting failure through the
+ * stream. Specialize it for T, or pass save and load any object with the
+ * same two members.
+ */
+template <typename T>
+struct deque_codec;
+
+/**
+ * The length as a uint64_t, then the characters.
+ */
+template <>
+struct deque_codec<std::string> {
+    void write (std::ostream& out, const std::string& v) const {
+        const std::uint64_t n = v.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(v.data(), n);}
+
+    std::string read (std::istream& in) const {
+        std::uint64_t n = 0;
+        if(!in.read(reinterpret_cast<char*>(&n), sizeof(n))){
+            return std::string();}
+        std::string v;
+        while(n != 0 && in){
+            char buffer[4096];
+            const std::size_t k = (n < sizeof(buffer)) ? static_cast<std::size_t>(n) : sizeof(buffer);
+            in.read(buffer, k);
+            v.append(buffer, static_cast<std::size_t>(in.gcount()));
+            n -= k;}
+        return v;}};
+
+// --------------------
+// deque_inline_storage
+// --------------------
+
+/**
+ * Room for N elements inside the my_deque object, plus a one-slot map that
+ * points at it, so that a small deque needs no heap at all.
+ */
+template <typename T, std::size_t N>
+struct deque_inline_storage {
+    T* _inline_map[1];
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type _inline_buffer;
+
+    T** inline_map () const {
+        return const_cast<T**>(_inline_map);}
+
+    T* inline_block () const {
+        return reinterpret_cast<T*>(const_cast<typename std::remove_const<decltype(_inline_buffer)>::type*>(&_inline_buffer));}};
+
+/**
+ * N == 0 costs nothing; my_deque inherits from this, so it takes no space.
+ */
+template <typename T>
+struct deque_inline_storage<T, 0> {
+    T** inline_map () const {
+        return 0;}
+
+    T* inline_block () const {
+        return 0;}};
 
+// -------
+// my_deque
+// -------
 
-            public:                
+/**
+ * N > 0 keeps up to N elements in the object itself; the deque moves to
+ * heap blocks the first time it needs more. Iterators into the inline
+ * storage point into the object, so moving the deque invalidates them.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t B = deque_block_size<T>::value, std::size_t N = 0 >
+class my_deque : private deque_inline_storage<T, N> {
+    static_assert(B > 0, "my_deque block size must be positive");
+    static_assert(N < B, "my_deque inline storage must be smaller than a block");
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator ( iterator _iter) : iter (_iter) {}
+    public:        
 
-                // Default copy, destructor, and copy assignment.
-                // const_iterator (const const_iterator&);
-                // ~const_iterator ();
-                // const_iterator& operator = (const const_iterator&);
-                
+        typedef A                                        allocator_type;
+        typedef typename allocator_type::value_type      value_type;
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<T*> outer_alloc_type;
 
-                /**
-                 * <your documentation>
-                 */
-                reference operator * () const {
-                    return *iter;                    
-                }
-            
+        typedef typename std::allocator_traits<allocator_type>::size_type         size_type;
+        typedef typename std::allocator_traits<allocator_type>::difference_type   difference_type;
+        typedef typename std::allocator_traits<outer_alloc_type>::size_type       outer_size_type;
+        typedef typename std::allocator_traits<outer_alloc_type>::difference_type outer_difference_type;
 
-                /**
-                 * <your documentation>
-                 */
-                pointer operator -> () const {
-                    return &**this;
-                }
-                
+        typedef typename std::allocator_traits<allocator_type>::pointer           pointer;
+        typedef typename std::allocator_traits<allocator_type>::const_pointer     const_pointer;
+        typedef typename std::allocator_traits<outer_alloc_type>::pointer         outer_pointer;
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator& operator ++ () {
-                    ++iter;
-                    return *this;                    
-                }
+        typedef value_type&                              reference;
+        typedef const value_type&                        const_reference;
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator operator ++ (int) {
-                    const_iterator x = *this;
-                    ++iter;
-                    return x;
-                }
+        typedef my_deque_iterator<T, T&, T*, B>             iterator;
+        typedef my_deque_iterator<T, const T&, const T*, B> const_iterator;
 
+        /**
+         * Emptied blocks kept for reuse by the growing end before being freed.
+         */
+        static const size_type spare_limit = 4;
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator& operator -- () {
-                    --iter;                    
-                    return *this;            
-                }
+    public:        
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator operator -- (int) {
-                    const_iterator x = *this;
-                    --iter;
-                    return x;
-                }
-                
+        /**
+         * Compares a block-aligned stretch at a time; see ::equal.
+         */
+        friend bool operator == (const my_deque& lhs, const my_deque& rhs) {
+            return (lhs.size() == rhs.size()) && ::equal(lhs.begin(), lhs.end(), rhs.begin());
+        }
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator& operator += (difference_type d) {
-                    iter += d;
-                    return *this;
-                }
-                
 
-                /**
-                 * <your documentation>
-                 */
-                const_iterator& operator -= (difference_type d) {
-                    iter -= d;
-                    return *this;
-                }
-            };
+        /**
+         * See ::lexicographical_compare.
+         */
+        friend bool operator < (const my_deque& lhs, const my_deque& rhs) {
+            return ::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+        }
+
+    private:        
+
+        allocator_type _a;
+        outer_alloc_type _o;        
+        T** arr_ptr;
+        size_type _l;        
+        size_type _b;
+        size_type _e;
+        size_type number_of_arrays;
+        T* _spare[spare_limit];
+        size_type _spare_count;
+        size_type _shrink_threshold = 0;
+
+#ifdef DEQUE_STATS
+        struct counters {
+            size_type map_reallocations = 0;
+            size_type high_water        = 0;};
+
+        counters _counters;
+#endif
+
+        /**
+         * Records a new size after the deque grows; nothing without DEQUE_STATS.
+         */
+        void note_growth () {
+#ifdef DEQUE_STATS
+            if(size() > _counters.high_water){
+                _counters.high_water = size();
+            }
+#endif
+        }
+
+        /**
+         * Records that a new map was allocated; nothing without DEQUE_STATS.
+         */
+        void note_map_reallocation () {
+#ifdef DEQUE_STATS
+            ++_counters.map_reallocations;
+#endif
+        }
+
+    private:        
+
+        bool valid () const {
+            if(arr_ptr == 0){
+                return (_b == 0) && (_e == 0) && (_l == 0);
+            }
+            if(is_inline()){
+                return (_b <= _e) && (_e <= N) && (_l == N + 1) && (number_of_arrays == 1);
+            }
+            return (_b <= _e) && (_e < _l) && (_l == number_of_arrays * B);
+        }
+        /**
+         * True while the map is the one-slot map inside the object. _l is
+         * then N + 1, so every growth check sends the deque to
+         * reserve_map_back or reserve_map_front before slot N.
+         */
+        bool is_inline () const {
+            return (N != 0) && (arr_ptr == this->inline_map());
+        }
+
+        /**
+         * Iterator at absolute slot i; i may be _e, whose node always exists.
+         */
+        iterator iterator_at (size_type i) const {
+            if(arr_ptr == 0){
+                return iterator();
+            }
+            return map_iterator(arr_ptr, i);
+        }
+
+        /**
+         * Iterator at absolute slot i of map, which need not be arr_ptr.
+         */
+        static iterator map_iterator (T** map, size_type i) {
+            T** node = map + i / B;
+            return iterator(*node + i % B, node);
+        }
+
+        // ----------
+        // allocators
+        // ----------
+
+        typedef std::allocator_traits<allocator_type> alloc_traits;
+
+        /**
+         * Takes that's allocators when the trait says they follow the
+         * contents; does nothing otherwise, so allocators that cannot be
+         * assigned, like polymorphic_allocator, still compile.
+         */
+        void copy_allocators (const my_deque& that, std::true_type) {
+            _a = that._a;
+            _o = that._o;
+        }
+
+        void copy_allocators (const my_deque&, std::false_type) {}
+
+        void move_allocators (my_deque& that, std::true_type) {
+            _a = std::move(that._a);
+            _o = std::move(that._o);
+        }
+
+        void move_allocators (my_deque&, std::false_type) {}
+
+        void swap_allocators (my_deque& that, std::true_type) {
+            std::swap(_a, that._a);
+            std::swap(_o, that._o);
+        }
+
+        void swap_allocators (my_deque&, std::false_type) {}
 
     public:        
 
@@ -451,39 +1084,122 @@ class my_deque {
         /**
          * <your documentation>
          */
-        explicit my_deque (const allocator_type& a = allocator_type())
-        {                        
-            Construct(a,outer_alloc_type());
+        explicit my_deque (const allocator_type& a = allocator_type()) : _a (a), _o (a)
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            assert(valid());
         }
-        explicit my_deque (const allocator_type& a, const outer_alloc_type& o = outer_alloc_type()) : _a(a), _o(o){
+
+        /**
+         * Uses o for the map instead of a copy of a.
+         */
+        my_deque (const allocator_type& a, const outer_alloc_type& o) : _a(a), _o(o){
             arr_ptr = 0;
+            _spare_count = 0;
             _b = _e = number_of_arrays = _l = 0;
-            new_empty_deque = true;
             assert(valid());
         }
 
         /**
          * <your documentation>
          */
-        explicit my_deque (size_type s, const_reference v = value_type(), const allocator_type& a = allocator_type()) : _a (a)
+        explicit my_deque (size_type s, const_reference v = value_type(), const allocator_type& a = allocator_type()) : _a (a), _o (a)
         {
             arr_ptr = 0;
+            _spare_count = 0;
             _b = _e = number_of_arrays = _l = 0;
-            new_empty_deque = true;
             this->resize(s,v);
             assert(valid());
         }
 
+        /**
+         * Copies [first, last); forward ranges are sized and allocated up front.
+         */
+        template <typename II, typename = typename std::enable_if<!std::is_integral<II>::value>::type>
+        my_deque (II first, II last, const allocator_type& a = allocator_type()) : _a (a), _o (a)
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            append_range(first, last);
+            assert(valid());
+        }
+
+        /**
+         * <your documentation>
+         */
+        my_deque (std::initializer_list<value_type> il, const allocator_type& a = allocator_type()) : _a (a), _o (a)
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            append_range(il.begin(), il.end());
+            assert(valid());
+        }
+
+        /**
+         * The copy's allocator comes from select_on_container_copy_construction.
+         */
+        my_deque (const my_deque& that) :
+                _a (alloc_traits::select_on_container_copy_construction(that._a)),
+                _o (_a)
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            _shrink_threshold = that._shrink_threshold;
+            append_range(that.begin(), that.end());
+            assert(valid());
+        }
 
         /**
          * <your documentation>
          */
-        my_deque (const my_deque& that) 
+        my_deque (const my_deque& that, const allocator_type& a) : _a (a), _o (a)
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            _shrink_threshold = that._shrink_threshold;
+            append_range(that.begin(), that.end());
+            assert(valid());
+        }
+
+        /**
+         * Steals that's map, blocks and spares; that is left empty.
+         * Inline elements are moved one by one instead.
+         */
+        my_deque (my_deque&& that) noexcept(N == 0 || std::is_nothrow_move_constructible<T>::value) :
+                _a (std::move(that._a)),
+                _o (std::move(that._o))
+        {
+            arr_ptr = 0;
+            _spare_count = 0;
+            _b = _e = number_of_arrays = _l = 0;
+            _shrink_threshold = that._shrink_threshold;
+            steal(that);
+            assert(valid());
+        }
+
+        /**
+         * Steals that's storage when a equals its allocator, otherwise
+         * moves the elements one by one and clears that.
+         */
+        my_deque (my_deque&& that, const allocator_type& a) : _a (a), _o (a)
         {
             arr_ptr = 0;
+            _spare_count = 0;
             _b = _e = number_of_arrays = _l = 0;
-            new_empty_deque = true;
-            *this = that;
+            _shrink_threshold = that._shrink_threshold;
+            if(_a == that._a){
+                steal(that);
+            }
+            else{
+                append_range(std::make_move_iterator(that.begin()), std::make_move_iterator(that.end()));
+                that.clear();
+            }
             assert(valid());
         }
 
@@ -495,24 +1211,86 @@ class my_deque {
          * <your documentation>
          */
         ~my_deque () {
-            for(int i = 0; i < number_of_arrays; ++i){
-                T* temp = arr_ptr[i];
-                destroy(_a,temp,temp+10);
-                _a.deallocate(temp,10);
-                
+            release_storage();
+        }        
+
+        /**
+         * Takes rhs's allocator first when propagate_on_container_copy_assignment
+         * says so; storage from a different old allocator is freed before that.
+         */
+        my_deque& operator = (const my_deque& rhs) {
+            typedef typename alloc_traits::propagate_on_container_copy_assignment propagate;
+            if(this == &rhs){
+                return *this;
+            }
+            if(propagate::value && !(_a == rhs._a)){
+                release_storage();
+            }
+            copy_allocators(rhs, propagate());
+            assign(rhs.begin(), rhs.end());
+            return *this;
+        }
+
+        /**
+         * <your documentation>
+         */
+        my_deque& operator = (std::initializer_list<value_type> il) {
+            assign(il.begin(), il.end());
+            return *this;
+        }
+
+        /**
+         * Replaces the contents with [first, last), reusing the blocks already held.
+         */
+        template <typename II, typename = typename std::enable_if<!std::is_integral<II>::value>::type>
+        void assign (II first, II last) {
+            size_type old_e = _e;
+            leaping_destroy(_a,_b,_e,arr_ptr);
+            _e = _b;
+            append_range(first, last);
+            if(old_e > _e){
+                release_blocks((_e + B - 1) / B, (old_e - 1) / B + 1);
             }
-            _o.deallocate(arr_ptr,number_of_arrays);
             assert(valid());
-        }        
+        }
 
         /**
          * <your documentation>
          */
-        my_deque& operator = (const my_deque& rhs) {
-            this->clear();
-            size_type rhs_size = rhs.size();
-            for(size_type i = 0; i < rhs_size; ++i){
-                this->push_back(rhs[i]);
+        void assign (size_type s, const_reference v) {
+            value_type copy(v);
+            clear();
+            resize(s, copy);
+        }
+
+        /**
+         * <your documentation>
+         */
+        void assign (std::initializer_list<value_type> il) {
+            assign(il.begin(), il.end());
+        }
+
+        /**
+         * Takes over rhs's storage when the allocators allow it,
+         * otherwise moves the elements one by one.
+         */
+        my_deque& operator = (my_deque&& rhs) {
+            typedef typename alloc_traits::propagate_on_container_move_assignment propagate;
+            if(this == &rhs){
+                return *this;
+            }
+            if(propagate::value || _a == rhs._a){
+                release_storage();
+                move_allocators(rhs, propagate());
+                steal(rhs);
+            }
+            else{
+                this->clear();
+                size_type rhs_size = rhs.size();
+                for(size_type i = 0; i < rhs_size; ++i){
+                    this->emplace_back(std::move(rhs[i]));
+                }
+                rhs.clear();
             }
             assert(valid());
             return *this;
@@ -526,8 +1304,8 @@ class my_deque {
             assert(index >= 0);
             assert(index < size());
             size_type adjusted_index = _b + index;
-            size_type inner_array_number = adjusted_index / INNER_SIZE;
-            size_type inner_array_index = adjusted_index % INNER_SIZE;
+            size_type inner_array_number = adjusted_index / B;
+            size_type inner_array_index = adjusted_index % B;
             T* inner_array = arr_ptr[inner_array_number] + inner_array_index;
 
             return *inner_array;
@@ -579,7 +1357,7 @@ class my_deque {
          */
         iterator begin () {
             
-            return iterator(this, _b);
+            return iterator_at(_b);
         }
 
         /**
@@ -587,388 +1365,1121 @@ class my_deque {
          */
         const_iterator begin () const {
             
-            const my_deque* const temp_p = this;
-            my_deque* uncasted = (my_deque*) temp_p;
-            size_type temp_b = _b;
-            iterator temp(uncasted, temp_b);
-            return const_iterator(temp);
+            return iterator_at(_b);
         }
         
 
         /**
-         * <your documentation>
+         * Destroys every element and releases every block; the empty deque
+         * is recentered in its map, so either end can grow without moving it.
          */
         void clear () {
-            if(size() > 0){
-                leaping_destroy(_a,_b,_e,arr_ptr);
-                _b = _e = size() / 2;
+            leaping_destroy(_a,_b,_e,arr_ptr);
+            release_blocks(0, number_of_arrays);
+            if(arr_ptr != 0){
+                _b = _e = is_inline() ? N / 2 : number_of_arrays / 2 * B;
             }
+            shrink_if_sparse();
             assert(valid());
         }
-        
 
         /**
-         * <your documentation>
+         * Opts in to giving memory back as the deque drains. With d > 0, a
+         * deque holding fewer than capacity / d elements frees its spare
+         * blocks and moves to a recentered map about twice the nodes in use.
+         * d is at least 4, so a deque that just shrank has to double before
+         * its map grows again and halve again before it shrinks again.
+         * 0, the default, never shrinks. The check runs only when a block is
+         * released, so pops that stay inside a block pay nothing for it.
+         * A shrink moves the map: with the policy on, pops and erases can
+         * invalidate iterators, though never references to live elements.
          */
-        bool empty () const {
-            return !size();
+        void set_shrink_threshold (size_type d) {
+            _shrink_threshold = (d == 0) ? 0 : std::max<size_type>(d, 4);
+            shrink_if_sparse();
         }
-        
 
         /**
          * <your documentation>
          */
-        iterator end () {
-            
-            return iterator(this, _e);
+        size_type shrink_threshold () const {
+            return _shrink_threshold;
         }
 
         /**
-         * <your documentation>
+         * Frees the spare blocks and every block without live elements,
+         * then shrinks the map to the nodes in use. An empty deque also
+         * gives up its map.
          */
-        const_iterator end () const {
-            
-            const my_deque* const temp_p = this;
-            my_deque* uncasted = (my_deque*) temp_p;
-            size_type temp_e = _e;
-            iterator temp(uncasted,temp_e);
-            return const_iterator(temp);
-        }
-        
-        size_type get_current_location(iterator& iter)
-        {
-            return iter.current_location;
+        void shrink_to_fit () {
+            free_spares();
+            if(arr_ptr == 0){
+                return;
+            }
+            if(is_inline()){
+                if(empty()){
+                    release_storage();
+                }
+                return;
+            }
+            size_type b_node = _b / B;
+            size_type e_node = _e / B;
+            size_type live_end = empty() ? b_node : (_e - 1) / B + 1;
+            for(size_type i = 0; i < number_of_arrays; ++i){
+                if((i < b_node || i >= live_end) && arr_ptr[i] != 0){
+                    _a.deallocate(arr_ptr[i], B);
+                    arr_ptr[i] = 0;
+                }
+            }
+            T** new_arr_ptr = 0;
+            size_type new_size = 0;
+            if(!empty()){
+                new_size = e_node - b_node + 1;
+                new_arr_ptr = _o.allocate(new_size);
+                std::copy(arr_ptr + b_node, arr_ptr + e_node + 1, new_arr_ptr);
+                note_map_reallocation();
+            }
+            _o.deallocate(arr_ptr, number_of_arrays);
+            size_type count = size();
+            arr_ptr = new_arr_ptr;
+            number_of_arrays = new_size;
+            _l = new_size * B;
+            _b = (new_size == 0) ? 0 : _b % B;
+            _e = _b + count;
+            assert(valid());
         }
 
         /**
-         * <your documentation>
+         * Grows the map and allocates the blocks for n more elements after
+         * the last one, without constructing any, so that the next n pushes
+         * at the back do not allocate. Reserving at the other end keeps
+         * this room; pops with a shrink policy set may give it back.
          */
-        iterator erase (iterator iter) {
-            // <your code>
-            size_type iterator_pos = get_current_location(iter) - _b;
-
-            for (int i = iterator_pos; i < size() - 1; ++i)
-            {
-                (*this)[i] = (*this)[i+1];
-            }
-            resize(size() -1);
+        void reserve_back (size_type n) {
+            reserve_back_storage(n);
             assert(valid());
-            return iter;
         }
-        
 
         /**
-         * <your documentation>
+         * The front counterpart of reserve_back.
          */
-        reference front () {
-            return (*this)[0];
+        void reserve_front (size_type n) {
+            if(n == 0){
+                return;
+            }
+            if(_b < n){
+                reserve_map_front(n);
+            }
+            allocate_blocks(_b - n, _b);
+            assert(valid());
         }
 
         /**
-         * <your documentation>
+         * How many pushes at the back are sure not to allocate: the map
+         * room after the last element, as far as allocated or spare blocks
+         * reach. At least what reserve_back last asked for.
          */
-        const_reference front () const {
-            return const_cast<my_deque*>(this)->front();
+        size_type capacity_back () const {
+            if(arr_ptr == 0 || is_inline()){
+                return N - size();
+            }
+            size_type spares = _spare_count;
+            size_type e = _e;
+            while(e + 1 < _l){
+                if(arr_ptr[e / B] == 0){
+                    if(spares == 0){
+                        break;
+                    }
+                    --spares;
+                }
+                e = (e / B + 1) * B;
+            }
+            return std::min(e, _l - 1) - _e;
         }
-        
-  
+
         /**
-         * <your documentation>
+         * The front counterpart of capacity_back.
          */
-        iterator insert (iterator iter, const_reference v) {
-            
-            if (empty())
-            {
-                (*this).push_back(v);
-                return (*this).begin();
-
-            }
-
-            size_type iterator_pos = get_current_location(iter) - _b;
-
-
-            my_deque copy;            
-
-            for (int i = iterator_pos; i < size(); ++i)
-            {
-                copy.push_back((*this)[i]);
+        size_type capacity_front () const {
+            if(arr_ptr == 0 || is_inline()){
+                return N - size();
             }
-
-            resize(iterator_pos, v);
-            (*this).push_back(v);
-            for (int i = 0; i < copy.size(); ++i)
-            {
-                (*this).push_back(copy[i]);
+            size_type spares = _spare_count;
+            size_type b = _b;
+            while(b > 0){
+                if(arr_ptr[(b - 1) / B] == 0){
+                    if(spares == 0){
+                        break;
+                    }
+                    --spares;
+                }
+                b = (b - 1) / B * B;
             }
-            
-            iter = begin() + iterator_pos;
-            return iter;
+            return _b - b;
         }
-        
 
+#ifdef DEQUE_STATS
         /**
-         * <your documentation>
+         * Where the memory is going: live elements, idle and spare blocks,
+         * slack at either end and the map. Walks the map, so O(map_slots).
          */
-        void pop_back () {
-            if(size() > 0){
-                size_type new_e = _e -1;
-                leaping_destroy(_a,new_e,_e,arr_ptr);
-                _e = new_e;
+        deque_stats stats () const {
+            deque_stats s;
+            s.size         = size();
+            s.blocks       = 0;
+            s.idle_blocks  = 0;
+            s.spare_blocks = _spare_count;
+            s.map_slots    = is_inline() ? 0 : number_of_arrays;
+            s.capacity     = is_inline() ? N : _l;
+            s.front_slack  = _b;
+            s.back_slack   = s.capacity - _e;
+            size_type b_node = _b / B;
+            size_type e_node = empty() ? b_node : (_e - 1) / B + 1;
+            for(size_type i = 0; i < number_of_arrays; ++i){
+                if(arr_ptr[i] != 0 && arr_ptr[i] != this->inline_block()){
+                    ++s.blocks;
+                    if(i < b_node || i >= e_node){
+                        ++s.idle_blocks;
+                    }
+                }
             }
-            assert(valid());
+            s.bytes_allocated   = (s.blocks + s.spare_blocks) * B * sizeof(T) + s.map_slots * sizeof(T*);
+            s.map_reallocations = _counters.map_reallocations;
+            s.high_water        = _counters.high_water;
+            return s;
         }
+#endif
 
         /**
-         * <your documentation>
+         * The contiguous runs of the first n elements.
          */
-        void pop_front () {
-            
-            if(size() > 0){
-                
-                size_type new_b = _b + 1;
-                leaping_destroy(_a,_b,new_b,arr_ptr);
-                _b = new_b;
-            }
-            assert(valid());
+        deque_segments<T, T&, T*, B> segments_front (size_type n) {
+            assert(n <= size());
+            return segments(begin(), begin() + n);
         }
-        
 
         /**
          * <your documentation>
          */
-        void push_back (const_reference v)
-        {            
-
-            size_type new_e = _e + 1;
-            
-            if(new_e > _l)
-            {    
+        deque_segments<T, const T&, const T*, B> segments_front (size_type n) const {
+            assert(n <= size());
+            return segments(begin(), begin() + n);
+        }
 
-                resize(size() + 1, v);
-                
-            }
-            else
-            {
-                size_type inner_array_number = _e / INNER_SIZE;
-                size_type inner_array_index = _e % INNER_SIZE;
+        /**
+         * Removes the first n elements, typically once segments_front(n)
+         * has been written out.
+         */
+        void consume_front (size_type n) {
+            assert(n <= size());
+            erase_at_front(n);
+            assert(valid());
+        }
 
-                T* inner_array = arr_ptr[inner_array_number];
-                T* inner_position = inner_array + inner_array_index;
-                T* inner_end = inner_position + 1;
-                uninitialized_fill(_a, inner_position, inner_end, v);
-                _e = new_e;
-            }
+        /**
+         * Allocates storage for n more elements after the last one and
+         * returns it as runs, for read or readv to fill. The elements are
+         * not live until commit_back; any other change to the deque
+         * discards them. Only for trivially copyable T.
+         */
+        deque_segments<T, T&, T*, B> prepare_back (size_type n) {
+            static_assert(std::is_trivially_copyable<T>::value, "prepare_back requires a trivially copyable T");
+            reserve_back_storage(n);
+            return segments(iterator_at(_e), iterator_at(_e + n));
+        }
 
+        /**
+         * Makes the first n slots from the last prepare_back live.
+         */
+        void commit_back (size_type n) {
+            static_assert(std::is_trivially_copyable<T>::value, "commit_back requires a trivially copyable T");
+            assert(n == 0 || (_e + n < _l && arr_ptr[(_e + n - 1) / B] != 0));
+            _e += n;
+            note_growth();
             assert(valid());
         }
 
         /**
-         * <your documentation>
+         * Writes a deque_header and the elements to out. Trivially copyable
+         * elements go out as raw bytes, one write per block; anything else
+         * goes through deque_codec<T>. Failure shows in out's state.
          */
-        void push_front (const_reference v) {            
-            int new_b = _b - 1;            
-            if(new_b < 0)
-            {
-                push_front_resize(1, v);
-            }
+        void save (std::ostream& out) const {
+            save_default(out, std::is_trivially_copyable<T>());
+        }
 
-            else
-            {
-                size_type inner_array_number = new_b / INNER_SIZE;
-                size_type inner_array_index = new_b % INNER_SIZE;                
+        /**
+         * Writes the elements one at a time with codec.write(out, v).
+         */
+        template <typename C>
+        void save (std::ostream& out, const C& codec) const {
+            write_header(out, deque_header::codec);
+            for(const_iterator it = begin(); it != end() && out; ++it){
+                codec.write(out, *it);
+            }
+        }
 
-                T* inner_array = arr_ptr[inner_array_number];
-                T* arr_begin = inner_array + inner_array_index;                
-                uninitialized_fill(_a, arr_begin, arr_begin+1, v);
-                _b = new_b;
+        /**
+         * Replaces the contents with what save wrote. The map and blocks
+         * are sized once from the header; raw bytes are read straight into
+         * the blocks, a block per read. On a bad header or a short read,
+         * in's failbit is set and the deque is left as it was.
+         */
+        void load (std::istream& in) {
+            load_default(in, std::is_trivially_copyable<T>());
+        }
+
+        /**
+         * Reads what save(out, codec) wrote, each element from codec.read(in).
+         */
+        template <typename C>
+        void load (std::istream& in, const C& codec) {
+            std::uint64_t n = 0;
+            if(!read_header(in, deque_header::codec, n)){
+                return;
+            }
+            my_deque x(_a);
+            x.reserve_back_storage(n);
+            for(; n != 0; --n){
+                value_type v = codec.read(in);
+                if(!in){
+                    return;
+                }
+                x.emplace_back(std::move(v));
             }
+            swap(x);
+        }
+        
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return !size();
+        }
+        
+
+        /**
+         * <your documentation>
+         */
+        iterator end () {
             
-            assert(valid());
+            return iterator_at(_e);
+        }
+
+        /**
+         * <your documentation>
+         */
+        const_iterator end () const {
+            
+            return iterator_at(_e);
         }
         
-        void push_front_resize(size_type s, const_reference v = value_type()){            
-            size_type num_new_arrs = s / INNER_SIZE + 1;
-            size_type one_sided_num_arrs = std::max(num_new_arrs, 2 * number_of_arrays);
-            num_new_arrs = 2*one_sided_num_arrs + number_of_arrays;
+        size_type get_current_location(iterator& iter)
+        {
+            return _b + (iter - begin());
+        }
 
-            T** new_arr_ptr = _o.allocate(num_new_arrs);
-            for(int i = 0; i < one_sided_num_arrs; ++i)
-            {
-                T* temp = _a.allocate(INNER_SIZE);
-                new_arr_ptr[i] = temp;
+        /**
+         * <your documentation>
+         */
+        iterator erase (iterator iter) {
+            if(iter == end()){
+                // Callers rely on erase(end()) dropping the last element.
+                pop_back();
+                return end();
             }
+            return erase(iter, iter + 1);
+        }
 
-            for(int i = one_sided_num_arrs; i < one_sided_num_arrs + number_of_arrays; ++i)
-            {
-                new_arr_ptr[i] = arr_ptr[i - one_sided_num_arrs];
+        /**
+         * Removes [first, last) by shifting whichever side of it is shorter.
+         */
+        iterator erase (iterator first, iterator last) {
+            difference_type index = first - begin();
+            size_type n = last - first;
+            if(n == 0){
+                return first;
+            }
+            size_type elems_after = size() - index - n;
+            if(size_type(index) < elems_after){
+                std::move_backward(begin(), first, last);
+                erase_at_front(n);
             }
+            else{
+                std::move(last, end(), first);
+                erase_at_back(n);
+            }
+            assert(valid());
+            return begin() + index;
+        }
+        
 
-            for(int i = one_sided_num_arrs + number_of_arrays; i < num_new_arrs; ++i)
-            {
-                T* temp = _a.allocate(INNER_SIZE);
-                new_arr_ptr[i] = temp;
+        /**
+         * <your documentation>
+         */
+        reference front () {
+            return (*this)[0];
+        }
+
+        /**
+         * <your documentation>
+         */
+        const_reference front () const {
+            return const_cast<my_deque*>(this)->front();
+        }
+        
+  
+        /**
+         * Constructs an element from args in front of iter.
+         */
+        template <typename... Args>
+        iterator emplace (iterator iter, Args&&... args) {
+            difference_type index = iter - begin();
+            if(index == 0){
+                emplace_front(std::forward<Args>(args)...);
+                return begin();
             }
-            size_type new_b = one_sided_num_arrs * INNER_SIZE - s;
-            size_type old_b = _b + one_sided_num_arrs * INNER_SIZE;
-            
-            leaping_fill(_a, new_b, old_b, new_arr_ptr, v);
-            
-            if(arr_ptr != 0){
-                _o.destroy(arr_ptr);
-                _o.deallocate(arr_ptr,number_of_arrays);
-            }                
-            arr_ptr = new_arr_ptr;
-            number_of_arrays = num_new_arrs;
-            _l = number_of_arrays * INNER_SIZE;
+            if(size_type(index) == size()){
+                emplace_back(std::forward<Args>(args)...);
+                return end() - 1;
+            }
+            value_type v(std::forward<Args>(args)...);
+            if(size_type(index) < size() / 2){
+                emplace_front(std::move(front()));
+                iterator pos = begin() + index;
+                std::move(begin() + 2, pos + 1, begin() + 1);
+                *pos = std::move(v);
+                return pos;
+            }
+            emplace_back(std::move(back()));
+            iterator pos = begin() + index;
+            std::move_backward(pos, end() - 2, end() - 1);
+            *pos = std::move(v);
+            return pos;
+        }
 
-            if(new_empty_deque){
-                _b = new_b;
-                _e = new_b + s;
-                new_empty_deque = false;
+        /**
+         * <your documentation>
+         */
+        iterator insert (iterator iter, value_type&& v) {
+            return emplace(iter, std::move(v));
+        }
+
+        /**
+         * Inserts [first, last) in front of iter. The new elements are added
+         * with a single growth step at the nearer end and rotated into place.
+         */
+        template <typename II, typename = typename std::enable_if<!std::is_integral<II>::value>::type>
+        iterator insert (iterator iter, II first, II last) {
+            return insert_range(iter - begin(), first, last, typename std::iterator_traits<II>::iterator_category());
+        }
+
+        /**
+         * <your documentation>
+         */
+        iterator insert (iterator iter, size_type s, const_reference v) {
+            difference_type index = iter - begin();
+            size_type old_size = size();
+            if(size_type(index) < old_size / 2){
+                push_front_resize(s, v);
+                std::rotate(begin(), begin() + s, begin() + s + index);
             }
             else{
-                _b = new_b;
-                _e = _e + one_sided_num_arrs * INNER_SIZE;
+                resize(old_size + s, v);
+                std::rotate(begin() + index, begin() + old_size, end());
             }
+            return begin() + index;
         }
-        void leaping_destroy(A& a, size_type b, size_type e, T** arr){
+
+        /**
+         * <your documentation>
+         */
+        iterator insert (iterator iter, std::initializer_list<value_type> il) {
+            return insert(iter, il.begin(), il.end());
+        }
+
+        /**
+         * <your documentation>
+         */
+        iterator insert (iterator iter, const_reference v) {
+            return emplace(iter, v);
+        }
+        
+
+        /**
+         * <your documentation>
+         */
+        void pop_back () {
+            if(size() > 0){
+                size_type new_e = _e -1;
+                T*& block = arr_ptr[new_e / B];
+                destroy(_a, block + new_e % B, block + new_e % B + 1);
+                _e = new_e;
+                if(new_e % B == 0){
+                    release_block(block);
+                    shrink_if_sparse();
+                }
+            }
+            assert(valid());
+        }
+
+        /**
+         * <your documentation>
+         */
+        void pop_front () {
             
-            size_type b_array = b / INNER_SIZE;
-            size_type b_index = b % INNER_SIZE;
+            if(size() > 0){
+                
+                size_type new_b = _b + 1;
+                T*& block = arr_ptr[_b / B];
+                destroy(_a, block + _b % B, block + _b % B + 1);
+                _b = new_b;
+                if(new_b % B == 0){
+                    release_block(block);
+                    shrink_if_sparse();
+                }
+            }
+            assert(valid());
+        }
 
-            size_type e_array = e / INNER_SIZE;
-            size_type e_index = e % INNER_SIZE;            
+        /**
+         * Removes the first n elements, destroying them a block at a time
+         * and releasing the blocks they empty.
+         */
+        void pop_front (size_type n) {
+            assert(n <= size());
+            if(n > 0){
+                erase_at_front(n);
+            }
+            assert(valid());
+        }
 
-            T* b_array_first = arr[b_array];
-            T* b_begin = b_array_first + b_index;
+        /**
+         * Removes the last n elements, destroying them a block at a time
+         * and releasing the blocks they empty.
+         */
+        void pop_back (size_type n) {
+            assert(n <= size());
+            if(n > 0){
+                erase_at_back(n);
+            }
+            assert(valid());
+        }
 
-            if(b_array == e_array){
-                T* arr_end = b_array_first + e_index;
-                destroy(a,b_begin,arr_end);
+        /**
+         * Moves the first n elements to x, front first, and removes them;
+         * each block's run is moved, destroyed and, once empty, released
+         * before the next. Returns the end of the output.
+         */
+        template <typename OI>
+        OI drain_front (size_type n, OI x) {
+            assert(n <= size());
+            const size_type new_b = _b + n;
+            while(_b != new_b){
+                const size_type stop = std::min(new_b, (_b / B + 1) * B);
+                T* const p = arr_ptr[_b / B] + _b % B;
+                T* const e = p + (stop - _b);
+                x = std::move(p, e, x);
+                destroy(_a, p, e);
+                _b = stop;
+                if(_b % B == 0){
+                    release_block(arr_ptr[_b / B - 1]);
+                }
             }
-            else
-            {
-                T* b_end = b_array_first + INNER_SIZE;
-                destroy(a, b_begin, b_end);
-                for(int i = b_array+1; i < e_array; ++i)
-                {
-                    T* current = arr[i];
-                    T* end_curr = current + INNER_SIZE;
-                    destroy(a, current, end_curr);
+            shrink_if_sparse();
+            assert(valid());
+            return x;
+        }
+
+        /**
+         * Moves the last n elements to x, back first, as a loop of back()
+         * and pop_back() would, and removes them a block at a time.
+         * Returns the end of the output.
+         */
+        template <typename OI>
+        OI drain_back (size_type n, OI x) {
+            assert(n <= size());
+            const size_type new_e = _e - n;
+            while(_e != new_e){
+                const size_type start = std::max(new_e, (_e - 1) / B * B);
+                T* const p = arr_ptr[start / B] + start % B;
+                T* const e = p + (_e - start);
+                x = std::move(std::reverse_iterator<T*>(e), std::reverse_iterator<T*>(p), x);
+                destroy(_a, p, e);
+                _e = start;
+                if(_e % B == 0){
+                    release_block(arr_ptr[_e / B]);
                 }
-                T* e_begin = arr[e_array];
-                T* e_end = e_begin + e_index;
-                destroy(a, e_begin, e_end);
             }
+            shrink_if_sparse();
+            assert(valid());
+            return x;
         }
-        void leaping_fill(A& a, size_type b, size_type e, T** arr, const value_type& v){
-            size_type b_array = b / INNER_SIZE;
-            size_type b_index = b % INNER_SIZE;
 
-            size_type e_array = e / INNER_SIZE;
-            size_type e_index = e % INNER_SIZE;
 
-            T* b_array_first = arr[b_array];
-            T* b_begin = b_array_first + b_index;
-          
-            if(b_array == e_array)
+        /**
+         * Constructs an element from args after the last one.
+         */
+        template <typename... Args>
+        reference emplace_back (Args&&... args)
+        {            
+            if(_e + 1 >= _l)
+            {    
+                reserve_map_back(1);
+            }
+            T*& block = arr_ptr[_e / B];
+            if(block == 0)
             {
-                T* arr_end = b_array_first + e_index;
-                uninitialized_fill(a, b_begin, arr_end, v);  
+                block = allocate_block();
             }
-            else
+            T* inner_position = block + _e % B;
+            std::allocator_traits<allocator_type>::construct(_a, inner_position, std::forward<Args>(args)...);
+            ++_e;
+            note_growth();
+
+            assert(valid());
+            return *inner_position;
+        }
+
+        /**
+         * Constructs an element from args before the first one.
+         */
+        template <typename... Args>
+        reference emplace_front (Args&&... args) {            
+            if(_b == 0)
             {
-                T* b_end = b_array_first + INNER_SIZE;
-                uninitialized_fill(a, b_begin, b_end, v);
-                for(int i = b_array+1; i < e_array; ++i)
-                {
-                    T* current = arr[i];
-                    T* end_curr = current + INNER_SIZE;
-                    uninitialized_fill(a, current, end_curr, v);
-                }
-                T* e_begin = arr[e_array];
-                T* e_end = e_begin + e_index;
-                uninitialized_fill(a, e_begin, e_end, v);
-            }    
+                reserve_map_front(1);
+            }
+            size_type new_b = _b - 1;
+            T*& block = arr_ptr[new_b / B];
+            if(block == 0)
+            {
+                block = allocate_block();
+            }
+            T* inner_position = block + new_b % B;
+            std::allocator_traits<allocator_type>::construct(_a, inner_position, std::forward<Args>(args)...);
+            _b = new_b;
+            note_growth();
+            
+            assert(valid());
+            return *inner_position;
         }
+
         /**
          * <your documentation>
          */
-        void resize (size_type s, const_reference v = value_type()) {            
-            
-            size_type special_e = s + _b;
+        void push_back (const_reference v) {
+            emplace_back(v);
+        }
 
-            if(s == size()){
+        /**
+         * <your documentation>
+         */
+        void push_back (value_type&& v) {
+            emplace_back(std::move(v));
+        }
+
+        /**
+         * <your documentation>
+         */
+        void push_front (const_reference v) {
+            emplace_front(v);
+        }
+
+        /**
+         * <your documentation>
+         */
+        void push_front (value_type&& v) {
+            emplace_front(std::move(v));
+        }
+        
+        /**
+         * Prepends s copies of v, growing the map at the front at most once.
+         */
+        void push_front_resize(size_type s, const_reference v = value_type()){            
+            if(s == 0){
+                return;
+            }
+            if(_b < s){
+                reserve_map_front(s);
+            }
+            size_type new_b = _b - s;
+            allocate_blocks(new_b, _b);
+            leaping_fill(_a, new_b, _b, arr_ptr, v);
+            _b = new_b;
+            note_growth();
+            assert(valid());
+        }
+        void leaping_destroy(A& a, size_type b, size_type e, T** arr){
+            if(b == e || trivially_destroyed<A, T>::value){
                 return;
             }
+            for_each_segment(map_iterator(arr, b), map_iterator(arr, e), [&a] (T* p, T* q) {
+                destroy(a, p, q);
+            });
+        }
+        /**
+         * Copy-constructs the elements starting at first into slots [b, e) of arr,
+         * a block at a time. Returns the source iterator one past the last copy.
+         */
+        template <typename FI>
+        FI leaping_copy(A& a, size_type b, size_type e, T** arr, FI first){
+            if(b == e){
+                return first;
+            }
+            size_type done = b;
+            try {
+                for_each_segment(map_iterator(arr, b), map_iterator(arr, e), [&] (T* p, T* q) {
+                    FI next = first;
+                    std::advance(next, q - p);
+                    uninitialized_copy(a, first, next, p);
+                    first = next;
+                    done += q - p;
+                });
+            }
+            catch (...) {
+                leaping_destroy(a, b, done, arr);
+                throw;
+            }
+            return first;
+        }
+        void leaping_fill(A& a, size_type b, size_type e, T** arr, const value_type& v){
+            if(b == e){
+                return;
+            }
+            size_type done = b;
+            try {
+                for_each_segment(map_iterator(arr, b), map_iterator(arr, e), [&] (T* p, T* q) {
+                    uninitialized_fill(a, p, q, v);
+                    done += q - p;
+                });
+            }
+            catch (...) {
+                leaping_destroy(a, b, done, arr);
+                throw;
+            }
+        }
+        /**
+         * <your documentation>
+         */
+        void resize (size_type s, const_reference v = value_type()) {            
             if (s < size()){
-                size_type diff = size() - s;
-                size_type new_e = _e - diff;
-                leaping_destroy(_a,new_e,_e,arr_ptr);
-                _e = new_e;
+                erase_at_back(size() - s);
             }            
-            else if(special_e <= _l){                
-                
-                size_type new_e_diff = s - size();                                
-                leaping_fill(_a, _e, special_e, arr_ptr, v);
+            else if (s > size()){
+                size_type new_e_diff = s - size();
+                if(_e + new_e_diff >= _l){
+                    reserve_map_back(new_e_diff);
+                }
+                allocate_blocks(_e, _e + new_e_diff);
+                leaping_fill(_a, _e, _e + new_e_diff, arr_ptr, v);
                 _e = _e + new_e_diff;
-                
+                note_growth();
+            }
+            assert(valid());
+        }
+        
+    private:
+        // ------
+        // blocks
+        // ------
+
+        /**
+         * Appends [first, last) one element at a time; all a single-pass range allows.
+         */
+        template <typename II>
+        void append_range (II first, II last, std::input_iterator_tag) {
+            for(; first != last; ++first){
+                emplace_back(*first);
+            }
+        }
+
+        /**
+         * Appends [first, last) after growing the map and allocating blocks once.
+         */
+        template <typename FI>
+        void append_range (FI first, FI last, std::forward_iterator_tag) {
+            size_type n = std::distance(first, last);
+            if(n == 0){
+                return;
+            }
+            if(_e + n >= _l){
+                reserve_map_back(n);
+            }
+            allocate_blocks(_e, _e + n);
+            leaping_copy(_a, _e, _e + n, arr_ptr, first);
+            _e += n;
+            note_growth();
+        }
+
+        /**
+         * <your documentation>
+         */
+        template <typename II>
+        void append_range (II first, II last) {
+            append_range(first, last, typename std::iterator_traits<II>::iterator_category());
+        }
+
+        /**
+         * Prepends [first, last), in order, after growing the map and allocating blocks once.
+         */
+        template <typename FI>
+        void prepend_range (FI first, FI last) {
+            size_type n = std::distance(first, last);
+            if(n == 0){
+                return;
+            }
+            if(_b < n){
+                reserve_map_front(n);
+            }
+            allocate_blocks(_b - n, _b);
+            leaping_copy(_a, _b - n, _b, arr_ptr, first);
+            _b -= n;
+            note_growth();
+        }
+
+        /**
+         * A single-pass range can only be appended, then rotated into place.
+         */
+        template <typename II>
+        iterator insert_range (difference_type index, II first, II last, std::input_iterator_tag) {
+            size_type old_size = size();
+            append_range(first, last);
+            std::rotate(begin() + index, begin() + old_size, end());
+            return begin() + index;
+        }
+
+        /**
+         * Adds the range at whichever end is nearer to index, so that only
+         * the shorter side is moved.
+         */
+        template <typename FI>
+        iterator insert_range (difference_type index, FI first, FI last, std::forward_iterator_tag) {
+            size_type old_size = size();
+            if(size_type(index) < old_size / 2){
+                size_type n = std::distance(first, last);
+                prepend_range(first, last);
+                std::rotate(begin(), begin() + n, begin() + n + index);
             }
             else{
-                
-                size_type new_e_diff = s - size();                
-                
-                size_type size_needed = special_e - _l;
-                size_type num_new_arrs = size_needed / INNER_SIZE + 1;
+                append_range(first, last);
+                std::rotate(begin() + index, begin() + old_size, end());
+            }
+            return begin() + index;
+        }
 
+        /**
+         * Destroys the first n elements and releases the blocks they leave empty.
+         */
+        void erase_at_front (size_type n) {
+            size_type new_b = _b + n;
+            leaping_destroy(_a,_b,new_b,arr_ptr);
+            release_blocks(_b / B, new_b / B);
+            _b = new_b;
+            shrink_if_sparse();
+        }
 
-                size_type one_sided_num_arrs = std::max(num_new_arrs, 2 * number_of_arrays);
-                num_new_arrs = 2*one_sided_num_arrs + number_of_arrays;
+        /**
+         * Destroys the last n elements and releases the blocks they leave empty.
+         */
+        void erase_at_back (size_type n) {
+            size_type new_e = _e - n;
+            leaping_destroy(_a,new_e,_e,arr_ptr);
+            release_blocks((new_e + B - 1) / B, (_e - 1) / B + 1);
+            _e = new_e;
+            shrink_if_sparse();
+        }
 
-                T** new_arr_ptr = _o.allocate(num_new_arrs);
-                
-                for(int i = 0; i < one_sided_num_arrs; ++i)
-                {                   
-                    T* temp = _a.allocate(INNER_SIZE);
-                    new_arr_ptr[i] = temp;
+        /**
+         * One uninitialized block of B elements, from the spare list when possible.
+         */
+        T* allocate_block () {
+            if(_spare_count > 0){
+                return _spare[--_spare_count];
+            }
+            return _a.allocate(B);
+        }
 
+        /**
+         * Empties a map slot, keeping its block as a spare while there is room.
+         * The inline block is never released.
+         */
+        void release_block (T*& block) {
+            if(block == this->inline_block()){
+                return;
+            }
+            if(_spare_count < spare_limit){
+                _spare[_spare_count++] = block;
+            }
+            else{
+                _a.deallocate(block, B);
+            }
+            block = 0;
+        }
+
+        /**
+         * Releases the blocks of nodes [b_node, e_node); none may hold live elements.
+         */
+        void release_blocks (size_type b_node, size_type e_node) {
+            for(size_type i = b_node; i < e_node; ++i){
+                if(arr_ptr[i] != 0){
+                    release_block(arr_ptr[i]);
                 }
-                
-                for(int i = one_sided_num_arrs; i < one_sided_num_arrs + number_of_arrays; ++i)
-                {                    
-                    new_arr_ptr[i] = arr_ptr[i - one_sided_num_arrs];
+            }
+        }
+
+        /**
+         * Frees every spare block.
+         */
+        void free_spares () {
+            while(_spare_count > 0){
+                _a.deallocate(_spare[--_spare_count], B);
+            }
+        }
+
+        /**
+         * The shrink policy: below capacity / _shrink_threshold elements,
+         * frees the spares and every block outside the live nodes, and
+         * moves the live nodes to the middle of a map of about twice their
+         * number. Does nothing unless that at least halves the map.
+         */
+        void shrink_if_sparse () {
+            if(_shrink_threshold == 0 || arr_ptr == 0 || is_inline() || size() * _shrink_threshold >= _l){
+                return;
+            }
+            size_type b_node = _b / B;
+            size_type e_node = _e / B;
+            size_type live_nodes = e_node - b_node + 1;
+            size_type new_size = std::max<size_type>(2 * live_nodes + 2, 8);
+            if(2 * new_size > number_of_arrays){
+                return;
+            }
+            free_spares();
+            size_type live_end = empty() ? b_node : (_e - 1) / B + 1;
+            for(size_type i = 0; i < number_of_arrays; ++i){
+                if((i < b_node || i >= live_end) && arr_ptr[i] != 0){
+                    _a.deallocate(arr_ptr[i], B);
+                    arr_ptr[i] = 0;
+                }
+            }
+            T** new_arr_ptr = _o.allocate(new_size);
+            std::fill(new_arr_ptr, new_arr_ptr + new_size, static_cast<T*>(0));
+            size_type new_start = (new_size - live_nodes) / 2;
+            std::copy(arr_ptr + b_node, arr_ptr + e_node + 1, new_arr_ptr + new_start);
+            _o.deallocate(arr_ptr, number_of_arrays);
+            size_type count = size();
+            arr_ptr = new_arr_ptr;
+            number_of_arrays = new_size;
+            _l = new_size * B;
+            _b = new_start * B + _b % B;
+            _e = _b + count;
+            note_map_reallocation();
+        }
+
+        /**
+         * Makes sure every node covering [b, e) has a block; slots outside stay untouched.
+         */
+        void allocate_blocks (size_type b, size_type e) {
+            if(b == e){
+                return;
+            }
+            T** last = arr_ptr + (e - 1) / B;
+            for(T** node = arr_ptr + b / B; node <= last; ++node){
+                if(*node == 0){
+                    *node = allocate_block();
                 }
+            }
+        }
 
-                for(int i = one_sided_num_arrs + number_of_arrays; i < num_new_arrs; ++i)
-                {
-                    T* temp = _a.allocate(INNER_SIZE);
-                    new_arr_ptr[i] = temp;   
+        // ---
+        // map
+        // ---
+
+        /**
+         * Grows or recenters the map so that n more elements fit after _e,
+         * keeping a node for the new end position.
+         */
+        void reserve_map_back (size_type n) {
+            if(N != 0){
+                if(arr_ptr == 0 && n <= N){
+                    start_inline(0);
+                    return;
                 }
+                if(is_inline()){
+                    if(_e + n <= N){
+                        return;
+                    }
+                    if(size() + n <= N){
+                        slide_inline(0);
+                        return;
+                    }
+                    spill((_e % B + n) / B, false);
+                    return;
+                }
+            }
+            size_type nodes_to_add = (_e % B + n) / B;
+            if(arr_ptr == 0 || _e / B + nodes_to_add >= number_of_arrays){
+                reallocate_map(nodes_to_add, false);
+            }
+        }
+
+        /**
+         * Grows or recenters the map so that n more elements fit before _b.
+         */
+        void reserve_map_front (size_type n) {
+            if(N != 0){
+                if(arr_ptr == 0 && n <= N){
+                    start_inline(N);
+                    return;
+                }
+                if(is_inline()){
+                    if(n <= _b){
+                        return;
+                    }
+                    if(size() + n <= N){
+                        slide_inline(N - size());
+                        return;
+                    }
+                    spill((n - _b % B + B - 1) / B, true);
+                    return;
+                }
+            }
+            size_type in_block = _b % B;
+            size_type nodes_to_add = (n <= in_block) ? 0 : (n - in_block + B - 1) / B;
+            if(arr_ptr == 0 || nodes_to_add > _b / B){
+                reallocate_map(nodes_to_add, true);
+            }
+        }
 
-                if(arr_ptr != 0){                    
-                    _o.destroy(arr_ptr);
-                    _o.deallocate(arr_ptr,number_of_arrays);
-                }                
+        /**
+         * Makes room for nodes_to_add more nodes at one end. Only map slots
+         * move; blocks stay where they are and new slots start out empty.
+         * The nodes in use are the live ones plus the runs of allocated
+         * blocks on either side, so room reserved at one end survives
+         * growth at the other. If the map is more than twice the nodes in
+         * use it is recentered in place, otherwise a larger map is allocated.
+         */
+        void reallocate_map (size_type nodes_to_add, bool add_at_front) {
+            size_type old_start = _b / B;
+            size_type old_nodes = 1;
+            if(arr_ptr != 0){
+                size_type old_last = _e / B;
+                while(old_start > 0 && arr_ptr[old_start - 1] != 0){
+                    --old_start;
+                }
+                while(old_last + 1 < number_of_arrays && arr_ptr[old_last + 1] != 0){
+                    ++old_last;
+                }
+                old_nodes = old_last - old_start + 1;
+            }
+            size_type new_nodes = old_nodes + nodes_to_add;
+            size_type new_start;
+
+            if(number_of_arrays > 2 * new_nodes){
+                new_start = (number_of_arrays - new_nodes) / 2 + (add_at_front ? nodes_to_add : 0);
+                T** map_end = arr_ptr + number_of_arrays;
+                if(new_start > old_start){
+                    std::rotate(arr_ptr, map_end - (new_start - old_start), map_end);
+                }
+                else if(new_start < old_start){
+                    std::rotate(arr_ptr, arr_ptr + (old_start - new_start), map_end);
+                }
+            }
+            else{
+                size_type new_size = number_of_arrays + std::max(number_of_arrays, nodes_to_add) + 2;
+                if(new_size < 8){
+                    new_size = 8;
+                }
+                T** new_arr_ptr = _o.allocate(new_size);
+                std::fill(new_arr_ptr, new_arr_ptr + new_size, static_cast<T*>(0));
+                new_start = (new_size - new_nodes) / 2 + (add_at_front ? nodes_to_add : 0);
+                for(size_type i = 0; i < number_of_arrays; ++i){
+                    size_type j = i + new_start - old_start;
+                    if(j < new_size){
+                        new_arr_ptr[j] = arr_ptr[i];
+                    }
+                    else if(arr_ptr[i] != 0){
+                        release_block(arr_ptr[i]);
+                    }
+                }
+                if(arr_ptr != 0 && !is_inline()){
+                    _o.deallocate(arr_ptr, number_of_arrays);
+                }
                 arr_ptr = new_arr_ptr;
-                number_of_arrays = num_new_arrs;
-                _l = number_of_arrays * INNER_SIZE;
-                if(new_empty_deque){
-                    _b = 0;
-                    _e = size_needed;
-                    new_empty_deque = false;
-                }
-                else{
-                    _b = _b + one_sided_num_arrs * INNER_SIZE;
-                    _e = _e + one_sided_num_arrs * INNER_SIZE + new_e_diff;
-                }                
-                leaping_fill(_a, _e - size_needed, _e, arr_ptr, v);
-                
+                number_of_arrays = new_size;
+                _l = number_of_arrays * B;
+                note_map_reallocation();
             }
-            
-            assert(valid());
+            size_type count = size();
+            _b = (new_start + _b / B - old_start) * B + _b % B;
+            _e = _b + count;
         }
-        
+
+        // ------
+        // inline
+        // ------
 
+        /**
+         * Switches an empty deque without storage to the inline block, at b.
+         */
+        void start_inline (size_type b) {
+            T** map = this->inline_map();
+            map[0] = this->inline_block();
+            arr_ptr = map;
+            number_of_arrays = 1;
+            _l = N + 1;
+            _b = _e = b;
+        }
+
+        /**
+         * Moves the inline elements so that they start at new_b.
+         */
+        void slide_inline (size_type new_b) {
+            T* p = arr_ptr[0];
+            size_type count = size();
+            if(new_b < _b){
+                for(size_type i = 0; i < count; ++i){
+                    std::allocator_traits<allocator_type>::construct(_a, p + new_b + i, std::move(p[_b + i]));
+                    destroy(_a, p + _b + i, p + _b + i + 1);
+                }
+            }
+            else if(new_b > _b){
+                for(size_type i = count; i > 0; --i){
+                    std::allocator_traits<allocator_type>::construct(_a, p + new_b + i - 1, std::move(p[_b + i - 1]));
+                    destroy(_a, p + _b + i - 1, p + _b + i);
+                }
+            }
+            _b = new_b;
+            _e = new_b + count;
+        }
+
+        /**
+         * Moves the inline elements to a heap block at the same offsets, then
+         * gives the deque a heap map with room for nodes_to_add more nodes.
+         */
+        void spill (size_type nodes_to_add, bool add_at_front) {
+            T* p = arr_ptr[0];
+            if(p == this->inline_block()){
+                T* block = allocate_block();
+                size_type done = _b;
+                try {
+                    for(; done < _e; ++done){
+                        std::allocator_traits<allocator_type>::construct(_a, block + done, std::move_if_noexcept(p[done]));
+                    }
+                }
+                catch (...) {
+                    destroy(_a, block + _b, block + done);
+                    release_block(block);
+                    throw;
+                }
+                destroy(_a, p + _b, p + _e);
+                arr_ptr[0] = block;
+            }
+            reallocate_map(nodes_to_add, add_at_front);
+        }
+
+    public:
         /**
          * <your documentation>
          */
@@ -979,34 +2490,264 @@ class my_deque {
         
 
         /**
-         * <your documentation>
+         * A copy of the element allocator.
+         */
+        allocator_type get_allocator () const {
+            return _a;
+        }
+
+        /**
+         * Swaps storage when propagate_on_container_swap is set or the
+         * allocators are equal; otherwise falls back to moving elements.
          */
         void swap (my_deque& that) {
-            if(_a == that._a){
-                T** temp = arr_ptr;
-                arr_ptr = that.arr_ptr;
-                that.arr_ptr = temp;
-                size_type temp_b = _b;
-                size_type temp_e = _e;
-                size_type temp_l = _l;
-                _b = that._b;
-                _e = that._e;
-                _l = that._l;
-                that._b = temp_b;
-                that._e = temp_e;
-                that._l = temp_l;
-                size_type temp_number_of_arrays = number_of_arrays;
-                bool temp_new_empty_deque = new_empty_deque;
-                number_of_arrays = that.number_of_arrays;
-                new_empty_deque = that.new_empty_deque;
-                that.number_of_arrays = temp_number_of_arrays;
-                that.new_empty_deque = temp_new_empty_deque;
+            typedef typename alloc_traits::propagate_on_container_swap propagate;
+            if((propagate::value || _a == that._a) && !is_inline() && !that.is_inline()){
+                swap_allocators(that, propagate());
+                std::swap(arr_ptr, that.arr_ptr);
+                std::swap(_b, that._b);
+                std::swap(_e, that._e);
+                std::swap(_l, that._l);
+                std::swap(number_of_arrays, that.number_of_arrays);
+                std::swap(_spare, that._spare);
+                std::swap(_spare_count, that._spare_count);
+#ifdef DEQUE_STATS
+                std::swap(_counters, that._counters);
+#endif
             }
             else{
-                my_deque temp_deque(*this);
-                *this = that;
-                that = temp_deque;
+                my_deque temp_deque(std::move(*this));
+                *this = std::move(that);
+                that = std::move(temp_deque);
             }            
-            assert(valid());}};
+            assert(valid());}
+
+        /**
+         * <your documentation>
+         */
+        friend void swap (my_deque& lhs, my_deque& rhs) {
+            lhs.swap(rhs);}
+
+    private:
+        // --
+        // io
+        // --
+
+        void save_default (std::ostream& out, std::true_type) const {
+            write_header(out, deque_header::bytes);
+            for_each_segment(begin(), end(), [&out] (const T* b, const T* e) {
+                if(out){
+                    out.write(reinterpret_cast<const char*>(b), (e - b) * sizeof(T));
+                }
+            });
+        }
+
+        void save_default (std::ostream& out, std::false_type) const {
+            save(out, deque_codec<T>());
+        }
+
+        void load_default (std::istream& in, std::true_type) {
+            std::uint64_t n = 0;
+            if(!read_header(in, deque_header::bytes, n)){
+                return;
+            }
+            my_deque x(_a);
+            x.reserve_back_storage(n);
+            x.read_bytes(in, n, trivially_copied<A, T>());
+            if(in){
+                swap(x);
+            }
+        }
+
+        void load_default (std::istream& in, std::false_type) {
+            load(in, deque_codec<T>());
+        }
+
+        void write_header (std::ostream& out, std::uint32_t encoding) const {
+            deque_header h = {{'M', 'Y', 'D', 'Q'}, 1, sizeof(T), encoding, size()};
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        }
+
+        /**
+         * Reads and checks a header; sets failbit if it is not one save
+         * wrote for this T and encoding.
+         */
+        bool read_header (std::istream& in, std::uint32_t encoding, std::uint64_t& n) {
+            deque_header h;
+            if(!in.read(reinterpret_cast<char*>(&h), sizeof(h))){
+                return false;
+            }
+            if(std::memcmp(h.magic, "MYDQ", 4) != 0 || h.version != 1 || h.element_size != sizeof(T) ||
+               h.encoding != encoding || h.size > size_type(-1) / (2 * sizeof(T))){
+                in.setstate(std::ios_base::failbit);
+                return false;
+            }
+            n = h.size;
+            return true;
+        }
+
+        /**
+         * Makes room for n more elements after _e: the map grows once and
+         * every block they need is allocated.
+         */
+        void reserve_back_storage (size_type n) {
+            if(n == 0){
+                return;
+            }
+            if(arr_ptr == 0 || _e + n >= _l){
+                reserve_map_back(n);
+            }
+            allocate_blocks(_e, _e + n);
+        }
+
+        /**
+         * Reads n elements' bytes into the reserved slots after _e, then
+         * makes them live if every read succeeded.
+         */
+        void read_bytes (std::istream& in, size_type n, std::true_type) {
+            for_each_segment(iterator_at(_e), iterator_at(_e + n), [&in] (T* b, T* e) {
+                if(in){
+                    in.read(reinterpret_cast<char*>(b), (e - b) * sizeof(T));
+                }
+            });
+            if(in){
+                _e += n;
+                note_growth();
+            }
+        }
+
+        /**
+         * An allocator that constructs on its own gets each element
+         * through construct.
+         */
+        void read_bytes (std::istream& in, size_type n, std::false_type) {
+            for(; n != 0; --n){
+                value_type v;
+                if(!in.read(reinterpret_cast<char*>(&v), sizeof(v))){
+                    return;
+                }
+                emplace_back(v);
+            }
+        }
+
+    private:
+        /**
+         * Destroys every element and frees all blocks, spares and the map,
+         * leaving the deque empty with no storage.
+         */
+        void release_storage () {
+            if(size() > 0){
+                leaping_destroy(_a,_b,_e,arr_ptr);
+            }
+            for(size_type i = 0; i < number_of_arrays; ++i){
+                if(arr_ptr[i] != 0 && arr_ptr[i] != this->inline_block()){
+                    _a.deallocate(arr_ptr[i],B);
+                }
+            }
+            free_spares();
+            if(arr_ptr != 0 && !is_inline()){
+                _o.deallocate(arr_ptr,number_of_arrays);
+            }
+            arr_ptr = 0;
+            _b = _e = number_of_arrays = _l = 0;
+        }
+
+        /**
+         * Takes that's storage; this must have none. that is left empty.
+         */
+        void steal (my_deque& that) {
+            std::copy(that._spare, that._spare + that._spare_count, _spare);
+            _spare_count = that._spare_count;
+            that._spare_count = 0;
+#ifdef DEQUE_STATS
+            _counters = that._counters;
+            that._counters = counters();
+#endif
+            if(that.is_inline()){
+                start_inline(that._b);
+                T* p = that.arr_ptr[0];
+                for(; _e < that._e; ++_e){
+                    std::allocator_traits<allocator_type>::construct(_a, arr_ptr[0] + _e, std::move(p[_e]));
+                }
+                that.release_storage();
+                return;
+            }
+            arr_ptr = that.arr_ptr;
+            _b = that._b;
+            _e = that._e;
+            _l = that._l;
+            number_of_arrays = that.number_of_arrays;
+            that.arr_ptr = 0;
+            that._b = that._e = that.number_of_arrays = that._l = 0;
+        }};
+
+template <typename T, typename A, std::size_t B, std::size_t N>
+const typename my_deque<T, A, B, N>::size_type my_deque<T, A, B, N>::spare_limit;
+
+#if __cplusplus >= 201703L
+// ---
+// pmr
+// ---
+
+/**
+ * my_deque on a std::pmr::memory_resource. The using-directive at the top
+ * of this header makes a bare pmr ambiguous with std::pmr, so write
+ * ::pmr::my_deque.
+ */
+namespace pmr {
+    template < typename T, std::size_t B = deque_block_size<T>::value, std::size_t N = 0 >
+    using my_deque = ::my_deque<T, std::pmr::polymorphic_allocator<T>, B, N>;}
+#endif
+
+// ----
+// hash
+// ----
+
+namespace std {
+    /**
+     * Hashes a my_deque a block at a time. Each element is folded into a
+     * 64-bit state: integers and pointers by their bits, floating point by
+     * its bits with -0.0 taken as 0.0 (they are ==), anything else by its
+     * own std::hash. Equal deques hash equally however their blocks fall.
+     */
+    template <typename T, typename A, std::size_t B, std::size_t N>
+    struct hash< my_deque<T, A, B, N> > {
+        typedef my_deque<T, A, B, N> argument_type;
+        typedef std::size_t          result_type;
+
+        private:
+            typedef std::integral_constant<int, 0> bits_tag;
+            typedef std::integral_constant<int, 1> floating_tag;
+            typedef std::integral_constant<int, 2> hashed_tag;
+
+            typedef std::integral_constant<int,
+                (sizeof(T) > sizeof(std::uint64_t))  ? 2 :
+                bitwise_comparable<T>::value         ? 0 :
+                std::is_floating_point<T>::value     ? 1 : 2> tag;
+
+            static std::uint64_t word (const T& v, bits_tag) {
+                std::uint64_t w = 0;
+                std::memcpy(&w, &v, sizeof(T));
+                return w;}
+
+            static std::uint64_t word (const T& v, floating_tag) {
+                return (v == T(0)) ? 0 : word(v, bits_tag());}
+
+            static std::uint64_t word (const T& v, hashed_tag) {
+                return std::hash<T>()(v);}
+
+            static std::uint64_t mix (std::uint64_t h, std::uint64_t w) {
+                return (((h << 5) | (h >> 59)) ^ w) * 0x9e3779b97f4a7c15ULL;}
+
+        public:
+            result_type operator () (const argument_type& x) const {
+                std::uint64_t h = x.size();
+                for_each_segment(x.begin(), x.end(), [&h] (const T* b, const T* e) {
+                    for (; b != e; ++b)
+                        h = mix(h, word(*b, tag()));});
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                return static_cast<result_type>(h);}};}
 
 #endif // Deque_h
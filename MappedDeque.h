@@ -0,0 +1,396 @@
+// ----------------------------
+// projects/deque/MappedDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// ----------------------------
+
+#ifndef MappedDeque_h
+#define MappedDeque_h
+
+// --------
+// includes
+// --------
+
+#include <cassert>      // assert
+#include <cerrno>       // errno
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t, uint64_t
+#include <cstring>      // memcmp, memcpy
+#include <new>          // placement new
+#include <stdexcept>    // invalid_argument, length_error, runtime_error
+#include <string>       // string
+#include <system_error> // generic_category, system_error
+#include <type_traits>  // is_trivially_copyable
+#include <vector>       // vector
+
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // madvise, mmap, msync, munmap
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close, ftruncate, sysconf
+
+#include "Deque.h"
+
+// ------------
+// mapped_deque
+// ------------
+
+/**
+ * A deque whose blocks live in a file mapped into memory, for queues
+ * larger than RAM. T must be trivially copyable, since its bytes are the
+ * file's contents.
+ *
+ * The file is a page-sized header followed by B-element blocks. The whole
+ * of max_bytes is mapped up front, so block k always sits at the same
+ * address and the map of block pointers only ever grows at the back; the
+ * file itself grows a block at a time. The header holds _b and _e, so
+ * constructing a mapped_deque on an existing file reopens the deque
+ * without reading or copying the elements.
+ *
+ * Only the hot_blocks blocks at either end are meant to stay resident.
+ * Blocks the front has passed and live blocks that fall further behind the
+ * back than that are given back with madvise; the kernel reads them in
+ * again if they are touched. The file grows only at the back, so there is
+ * no push_front; when the deque empties, the indices restart at 0 and the
+ * file is cut back to hot_blocks blocks.
+ *
+ * B * sizeof(T) must be a multiple of the page size.
+ */
+template <typename T, std::size_t B = 65536>
+class mapped_deque {
+    static_assert(B > 0, "mapped_deque block size must be positive");
+    static_assert(std::is_trivially_copyable<T>::value, "mapped_deque requires a trivially copyable T");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef T                                           value_type;
+        typedef std::size_t                                 size_type;
+        typedef std::ptrdiff_t                              difference_type;
+        typedef T&                                          reference;
+        typedef const T&                                    const_reference;
+        typedef my_deque_iterator<T, T&, T*, B>             iterator;
+        typedef my_deque_iterator<T, const T&, const T*, B> const_iterator;
+
+        /**
+         * Blocks kept resident at each end.
+         */
+        static const size_type hot_blocks = 2;
+
+    private:
+        /**
+         * The first page of the file.
+         */
+        struct header {
+            char          magic[4];     // "MDEQ"
+            std::uint32_t version;      // 1
+            std::uint64_t element_size; // sizeof(T)
+            std::uint64_t block_size;   // B
+            std::uint64_t blocks;       // blocks in the file
+            std::uint64_t b;            // index of the front element
+            std::uint64_t e;};          // one past the back element
+
+    private:
+        // ----
+        // data
+        // ----
+
+        int              _fd;
+        char*            _base;
+        size_type        _reserved;
+        size_type        _page;
+        header*          _h;
+        std::vector<T*>  _map;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_h->b <= _h->e) && (_h->e <= _h->blocks * B) && (_map.size() == _h->blocks + 1);}
+
+        // -------
+        // helpers
+        // -------
+
+        static size_type block_bytes () {
+            return B * sizeof(T);}
+
+        /**
+         * Throws what errno says about the call named what.
+         */
+        static void fail (const char* what) {
+            throw std::system_error(errno, std::generic_category(), std::string("mapped_deque: ") + what);}
+
+        T* block (size_type k) const {
+            return reinterpret_cast<T*>(_base + _page + k * block_bytes());}
+
+        /**
+         * Drops block k's pages from memory; the file keeps the data.
+         */
+        void release (size_type k) {
+            ::madvise(block(k), block_bytes(), MADV_DONTNEED);}
+
+        /**
+         * Asks for block k to be read in ahead of use.
+         */
+        void prefetch (size_type k) {
+            if (k < _h->blocks)
+                ::madvise(block(k), block_bytes(), MADV_WILLNEED);}
+
+        /**
+         * Resizes the file to n blocks and the map to match.
+         */
+        void set_blocks (size_type n) {
+            if (_page + n * block_bytes() > _reserved)
+                throw std::length_error("mapped_deque: file would exceed max_bytes");
+            if (::ftruncate(_fd, static_cast<off_t>(_page + n * block_bytes())) != 0)
+                fail("ftruncate");
+            _h->blocks = n;
+            const size_type old = _map.size();
+            _map.resize(n + 1);
+            for (size_type k = old; k < n + 1; ++k)
+                _map[k] = block(k);}
+
+        /**
+         * Once the deque is empty the indices go back to 0 and the file
+         * back to hot_blocks blocks.
+         */
+        void restart_if_empty () {
+            if (_h->b != _h->e)
+                return;
+            _h->b = _h->e = 0;
+            if (_h->blocks > hot_blocks)
+                set_blocks(hot_blocks);}
+
+        void close_all () {
+            if (_base != 0)
+                ::munmap(_base, _reserved);
+            if (_fd >= 0)
+                ::close(_fd);}
+
+        /**
+         * Fills in the header of a new file, or checks that of an old one
+         * whose size is file_size.
+         */
+        void open_header (const std::string& path, bool fresh, size_type file_size) {
+            if (fresh) {
+                std::memcpy(_h->magic, "MDEQ", 4);
+                _h->version      = 1;
+                _h->element_size = sizeof(T);
+                _h->block_size   = B;
+                _h->blocks       = 0;
+                _h->b = _h->e    = 0;}
+            else if ((std::memcmp(_h->magic, "MDEQ", 4) != 0) || (_h->version != 1) ||
+                     (_h->element_size != sizeof(T)) || (_h->block_size != B) ||
+                     (file_size != _page + _h->blocks * block_bytes()))
+                throw std::runtime_error("mapped_deque: " + path + " is not a deque of this type");
+            if (file_bytes() > _reserved)
+                throw std::length_error("mapped_deque: " + path + " is larger than max_bytes");}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Opens path, creating it if it does not exist, and maps max_bytes of
+         * address space for it. An existing file must have been written by
+         * a mapped_deque of the same T and B; its elements are used in place.
+         */
+        explicit mapped_deque (const std::string& path, size_type max_bytes = size_type(1) << 40) :
+                _fd       (-1),
+                _base     (0),
+                _reserved (0),
+                _page     (static_cast<size_type>(::sysconf(_SC_PAGESIZE))),
+                _h        (0) {
+            if ((block_bytes() % _page != 0) || (max_bytes < _page))
+                throw std::invalid_argument("mapped_deque: blocks must be whole pages");
+            _reserved = max_bytes / _page * _page;
+            try {
+                _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+                if (_fd < 0)
+                    fail("open");
+                struct stat st;
+                if (::fstat(_fd, &st) != 0)
+                    fail("fstat");
+                const bool fresh = (st.st_size == 0);
+                if (fresh && (::ftruncate(_fd, static_cast<off_t>(_page)) != 0))
+                    fail("ftruncate");
+                void* p = ::mmap(0, _reserved, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+                if (p == MAP_FAILED)
+                    fail("mmap");
+                _base = static_cast<char*>(p);
+                _h    = reinterpret_cast<header*>(_base);
+                open_header(path, fresh, static_cast<size_type>(st.st_size));
+                _map.resize(_h->blocks + 1);
+                for (size_type k = 0; k != _map.size(); ++k)
+                    _map[k] = block(k);}
+            catch (...) {
+                close_all();
+                throw;}
+            assert(valid());}
+
+        mapped_deque (const mapped_deque&) = delete;
+        mapped_deque& operator = (const mapped_deque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Unmaps the file; the kernel writes dirty pages back in its own
+         * time. Call flush first to wait for them.
+         */
+        ~mapped_deque () {
+            close_all();}
+
+        // ----
+        // ends
+        // ----
+
+        /**
+         * Starting a block may grow the file, and gives back the live block
+         * that just fell hot_blocks behind, unless the front still needs it.
+         */
+        void push_back (const_reference v) {
+            const size_type e = _h->e;
+            const size_type k = e / B;
+            if (e % B == 0) {
+                if (k == _h->blocks)
+                    set_blocks(k + 1);
+                if ((k > hot_blocks) && (k - hot_blocks - 1 >= _h->b / B + hot_blocks))
+                    release(k - hot_blocks - 1);}
+            ::new (static_cast<void*>(_map[k] + e % B)) T(v);
+            _h->e = e + 1;}
+
+        /**
+         * <your documentation>
+         */
+        void pop_back () {
+            assert(!empty());
+            const size_type e = --_h->e;
+            if (e % B == 0) {
+                release(e / B);
+                if (e / B >= hot_blocks)
+                    prefetch(e / B - hot_blocks);}
+            restart_if_empty();}
+
+        /**
+         * Leaving a block gives it back and asks for the one hot_blocks
+         * ahead, which push_back may have given back.
+         */
+        void pop_front () {
+            assert(!empty());
+            const size_type b = ++_h->b;
+            if (b % B == 0) {
+                release(b / B - 1);
+                prefetch(b / B + hot_blocks);}
+            restart_if_empty();}
+
+        /**
+         * Writes every dirty page to the file and waits for it.
+         */
+        void flush () {
+            if (::msync(_base, file_bytes(), MS_SYNC) != 0)
+                fail("msync");}
+
+        // ---------
+        // accessors
+        // ---------
+
+        /**
+         * <your documentation>
+         */
+        reference operator [] (size_type index) {
+            assert(index < size());
+            const size_type i = _h->b + index;
+            return _map[i / B][i % B];}
+
+        /**
+         * <your documentation>
+         */
+        const_reference operator [] (size_type index) const {
+            return const_cast<mapped_deque*>(this)->operator[](index);}
+
+        /**
+         * <your documentation>
+         */
+        reference front () {
+            return (*this)[0];}
+
+        /**
+         * <your documentation>
+         */
+        const_reference front () const {
+            return (*this)[0];}
+
+        /**
+         * <your documentation>
+         */
+        reference back () {
+            return (*this)[size() - 1];}
+
+        /**
+         * <your documentation>
+         */
+        const_reference back () const {
+            return (*this)[size() - 1];}
+
+        // ---------
+        // iterators
+        // ---------
+
+        /**
+         * Iterators stay valid until a push_back grows the file or a pop
+         * empties the deque.
+         */
+        iterator begin () {
+            return iterator(_map[_h->b / B] + _h->b % B, &_map[_h->b / B]);}
+
+        /**
+         * <your documentation>
+         */
+        iterator end () {
+            return iterator(_map[_h->e / B] + _h->e % B, &_map[_h->e / B]);}
+
+        /**
+         * <your documentation>
+         */
+        const_iterator begin () const {
+            return const_cast<mapped_deque*>(this)->begin();}
+
+        /**
+         * <your documentation>
+         */
+        const_iterator end () const {
+            return const_cast<mapped_deque*>(this)->end();}
+
+        // ---------
+        // observers
+        // ---------
+
+        /**
+         * <your documentation>
+         */
+        size_type size () const {
+            return _h->e - _h->b;}
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return size() == 0;}
+
+        /**
+         * Bytes of file the deque uses, header included.
+         */
+        size_type file_bytes () const {
+            return _page + _h->blocks * block_bytes();}};
+
+template <typename T, std::size_t B>
+const typename mapped_deque<T, B>::size_type mapped_deque<T, B>::hot_blocks;
+
+#endif // MappedDeque_h
@@ -0,0 +1,181 @@
+// ------------------------------
+// projects/deque/ParallelDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// ------------------------------
+
+#ifndef ParallelDeque_h
+#define ParallelDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm>  // inplace_merge, min, sort
+#include <cstddef>    // size_t
+#include <exception>  // exception_ptr, current_exception, rethrow_exception
+#include <functional> // less
+#include <iterator>   // iterator_traits
+#include <thread>     // hardware_concurrency, thread
+#include <vector>     // vector
+
+#include "Deque.h"
+
+// ----------------
+// parallel_threads
+// ----------------
+
+/**
+ * The number of threads a parallel algorithm uses when it is given 0.
+ */
+inline std::size_t parallel_threads (std::size_t threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    return (threads == 0) ? 1 : threads;}
+
+// ----------------
+// split_on_blocks
+// ----------------
+
+/**
+ * Cuts [first, last) into at most parts chunks of about the same length.
+ * Every cut falls on a block boundary, so no block is shared by two chunks.
+ * Returns the cuts, first and last included.
+ */
+template <typename T, typename R, typename P, std::size_t B>
+std::vector< my_deque_iterator<T, R, P, B> > split_on_blocks (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, std::size_t parts) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    const std::size_t n   = last - first;
+    const std::size_t off = first.local() - iterator::segment_begin(first.segment());
+    std::vector<iterator> cuts(1, first);
+    for (std::size_t k = 1; k < parts; ++k) {
+        const std::size_t p = std::min(((n * k / parts + off + B - 1) / B) * B - off, n);
+        if (p != static_cast<std::size_t>(cuts.back() - first))
+            cuts.push_back(first + p);}
+    if (cuts.back() != last)
+        cuts.push_back(last);
+    return cuts;}
+
+// -----------
+// run_chunks
+// -----------
+
+/**
+ * Calls f(i) for each chunk i in [0, n), chunk 0 on the calling thread and
+ * every other chunk on a thread of its own. The first exception thrown by
+ * any chunk is rethrown once all of them have finished.
+ */
+template <typename F>
+void run_chunks (std::size_t n, F f) {
+    std::vector<std::exception_ptr> errors(n);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < n; ++i)
+        threads.push_back(std::thread([&f, &errors, i] () {
+            try {
+                f(i);}
+            catch (...) {
+                errors[i] = std::current_exception();}}));
+    if (n != 0) {
+        try {
+            f(0);}
+        catch (...) {
+            errors[0] = std::current_exception();}}
+    for (std::thread& t : threads)
+        t.join();
+    for (std::size_t i = 0; i < n; ++i)
+        if (errors[i])
+            std::rethrow_exception(errors[i]);}
+
+// -----------------
+// parallel_for_each
+// -----------------
+
+/**
+ * Calls f on every element of [first, last), one chunk of whole blocks per
+ * thread. Each thread gets its own copy of f.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename UF>
+void parallel_for_each (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, UF f, std::size_t threads = 0) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    const std::vector<iterator> cuts = split_on_blocks(first, last, parallel_threads(threads));
+    run_chunks(cuts.size() - 1, [&cuts, &f] (std::size_t i) {
+        for_each(cuts[i], cuts[i + 1], f);});}
+
+// ------------------
+// parallel_transform
+// ------------------
+
+/**
+ * Writes f(*i) to x + (i - first) for every i in [first, last).
+ * x must be a random access iterator; returns x + (last - first).
+ */
+template <typename T, typename R, typename P, std::size_t B, typename RI, typename UF>
+RI parallel_transform (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, RI x, UF f, std::size_t threads = 0) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    const std::vector<iterator> cuts = split_on_blocks(first, last, parallel_threads(threads));
+    run_chunks(cuts.size() - 1, [&cuts, &first, &x, &f] (std::size_t i) {
+        RI y = x + (cuts[i] - first);
+        for_each_segment(cuts[i], cuts[i + 1], [&y, &f] (P b, P e) {
+            y = std::transform(b, e, y, f);});});
+    return x + (last - first);}
+
+// ---------------
+// parallel_reduce
+// ---------------
+
+/**
+ * Folds each chunk left to right from its first element, then folds v with
+ * the chunk results in order. Equal to accumulate(first, last, v, f) when
+ * f is associative; for floating point the rounding can differ.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U, typename BF>
+U parallel_reduce (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, U v, BF f, std::size_t threads = 0) {
+    typedef my_deque_iterator<T, R, P, B> iterator;
+    const std::vector<iterator> cuts = split_on_blocks(first, last, parallel_threads(threads));
+    std::vector<U> partial(cuts.size() - 1);
+    run_chunks(cuts.size() - 1, [&cuts, &partial, &f] (std::size_t i) {
+        partial[i] = accumulate(cuts[i] + 1, cuts[i + 1], U(*cuts[i]), f);});
+    for (std::size_t i = 0; i != partial.size(); ++i)
+        v = f(v, partial[i]);
+    return v;}
+
+/**
+ * parallel_reduce with +, on every hardware thread.
+ */
+template <typename T, typename R, typename P, std::size_t B, typename U>
+U parallel_reduce (my_deque_iterator<T, R, P, B> first, my_deque_iterator<T, R, P, B> last, U v) {
+    return parallel_reduce(first, last, v, [] (const U& a, const U& b) {return a + b;});}
+
+// -------------
+// parallel_sort
+// -------------
+
+/**
+ * Sorts each chunk on its own thread, then merges neighbouring chunks
+ * pairwise with inplace_merge, again one merge per thread, until one
+ * chunk is left. Like sort, it is not stable.
+ */
+template <typename T, std::size_t B, typename BF>
+void parallel_sort (my_deque_iterator<T, T&, T*, B> first, my_deque_iterator<T, T&, T*, B> last, BF f, std::size_t threads = 0) {
+    typedef my_deque_iterator<T, T&, T*, B> iterator;
+    std::vector<iterator> cuts = split_on_blocks(first, last, parallel_threads(threads));
+    run_chunks(cuts.size() - 1, [&cuts, &f] (std::size_t i) {
+        std::sort(cuts[i], cuts[i + 1], f);});
+    while (cuts.size() > 2) {
+        run_chunks((cuts.size() - 1) / 2, [&cuts, &f] (std::size_t i) {
+            std::inplace_merge(cuts[2 * i], cuts[2 * i + 1], cuts[2 * i + 2], f);});
+        std::vector<iterator> merged;
+        for (std::size_t i = 0; i < cuts.size(); i += 2)
+            merged.push_back(cuts[i]);
+        if (merged.back() != cuts.back())
+            merged.push_back(cuts.back());
+        cuts.swap(merged);}}
+
+/**
+ * parallel_sort with <, on every hardware thread.
+ */
+template <typename T, std::size_t B>
+void parallel_sort (my_deque_iterator<T, T&, T*, B> first, my_deque_iterator<T, T&, T*, B> last) {
+    parallel_sort(first, last, std::less<T>());}
+
+#endif // ParallelDeque_h
@@ -0,0 +1,351 @@
+// --------------------------
+// projects/deque/RingDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// --------------------------
+
+#ifndef RingDeque_h
+#define RingDeque_h
+
+// --------
+// includes
+// --------
+
+#include <algorithm> // min
+#include <cassert>   // assert
+#include <cstddef>   // size_t
+#include <memory>    // allocator, allocator_traits
+#include <utility>   // forward, move
+
+#include "Deque.h"
+
+// ----------
+// ring_deque
+// ----------
+
+/**
+ * Fixed-capacity deque over the same B-element blocks as my_deque. Every
+ * block is allocated by the constructor, so no push or pop allocates.
+ *
+ * Slots are numbered 0 to capacity - 1 across the blocks; _b is the slot
+ * of the front element and the back wraps around to slot 0. When the ring
+ * is full, try_push_back and push_front refuse, and push_back_overwrite
+ * replaces the oldest element.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t B = deque_block_size<T>::value >
+class ring_deque {
+    static_assert(B > 0, "ring_deque block size must be positive");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef A                                                          allocator_type;
+        typedef typename allocator_type::value_type                        value_type;
+        typedef typename std::allocator_traits<allocator_type>::size_type  size_type;
+        typedef typename std::allocator_traits<allocator_type>::pointer    pointer;
+        typedef value_type&                                                reference;
+        typedef const value_type&                                          const_reference;
+
+    private:
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<T*> map_alloc_type;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        allocator_type _a;
+        map_alloc_type _o;
+        T**            _map;
+        size_type      _nodes;
+        size_type      _capacity;
+        size_type      _b;
+        size_type      _size;
+
+    private:
+        // -----
+        // valid
+        // -----
+
+        bool valid () const {
+            return (_size <= _capacity) && ((_capacity == 0) || (_b < _capacity)) && (_nodes * B >= _capacity);}
+
+        // -----
+        // slots
+        // -----
+
+        /**
+         * The storage of slot i.
+         */
+        pointer slot (size_type i) const {
+            return _map[i / B] + i % B;}
+
+        /**
+         * The slot k places after slot i, for k <= capacity.
+         */
+        size_type advance (size_type i, size_type k) const {
+            i += k;
+            return (i >= _capacity) ? i - _capacity : i;}
+
+        /**
+         * The slot before slot i.
+         */
+        size_type retreat (size_type i) const {
+            return (i == 0) ? _capacity - 1 : i - 1;}
+
+        /**
+         * Destroys the elements in slots [b, e), a block at a time; b <= e.
+         */
+        void destroy_slots (size_type b, size_type e) {
+            while (b != e) {
+                const size_type stop = std::min(e, (b / B + 1) * B);
+                destroy(_a, slot(b), slot(b) + (stop - b));
+                b = stop;}}
+
+        /**
+         * Frees the first n blocks and the map.
+         */
+        void release_blocks (size_type n) {
+            for (size_type i = 0; i != n; ++i)
+                _a.deallocate(_map[i], B);
+            _o.deallocate(_map, _nodes);}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * Allocates room for capacity elements; the ring starts empty.
+         */
+        explicit ring_deque (size_type capacity, const allocator_type& a = allocator_type()) :
+                _a        (a),
+                _o        (a),
+                _map      (0),
+                _nodes    ((capacity + B - 1) / B),
+                _capacity (capacity),
+                _b        (0),
+                _size     (0) {
+            _map = _o.allocate(_nodes);
+            size_type i = 0;
+            try {
+                for (; i != _nodes; ++i)
+                    _map[i] = _a.allocate(B);}
+            catch (...) {
+                release_blocks(i);
+                throw;}
+            assert(valid());}
+
+        ring_deque (const ring_deque&) = delete;
+        ring_deque& operator = (const ring_deque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * <your documentation>
+         */
+        ~ring_deque () {
+            clear();
+            release_blocks(_nodes);}
+
+        // ----
+        // back
+        // ----
+
+        /**
+         * Constructs an element at the back unless the ring is full.
+         * Returns whether it did.
+         */
+        template <typename... Args>
+        bool try_emplace_back (Args&&... args) {
+            if (_size == _capacity)
+                return false;
+            std::allocator_traits<allocator_type>::construct(_a, slot(advance(_b, _size)), std::forward<Args>(args)...);
+            ++_size;
+            return true;}
+
+        /**
+         * <your documentation>
+         */
+        bool try_push_back (const_reference v) {
+            return try_emplace_back(v);}
+
+        /**
+         * <your documentation>
+         */
+        bool try_push_back (value_type&& v) {
+            return try_emplace_back(std::move(v));}
+
+        /**
+         * Appends v; when the ring is full, v is assigned over the front
+         * element, which becomes the back. Returns whether an element was
+         * dropped.
+         */
+        bool push_back_overwrite (const_reference v) {
+            if (try_push_back(v))
+                return false;
+            if (_capacity == 0)
+                return true;
+            *slot(_b) = v;
+            _b = advance(_b, 1);
+            return true;}
+
+        /**
+         * <your documentation>
+         */
+        bool push_back_overwrite (value_type&& v) {
+            if (try_push_back(std::move(v)))
+                return false;
+            if (_capacity == 0)
+                return true;
+            *slot(_b) = std::move(v);
+            _b = advance(_b, 1);
+            return true;}
+
+        /**
+         * <your documentation>
+         */
+        void pop_back () {
+            assert(!empty());
+            --_size;
+            destroy_slots(advance(_b, _size), advance(_b, _size) + 1);}
+
+        // -----
+        // front
+        // -----
+
+        /**
+         * Constructs an element at the front unless the ring is full.
+         * Returns whether it did.
+         */
+        template <typename... Args>
+        bool emplace_front (Args&&... args) {
+            if (_size == _capacity)
+                return false;
+            const size_type b = retreat(_b);
+            std::allocator_traits<allocator_type>::construct(_a, slot(b), std::forward<Args>(args)...);
+            _b = b;
+            ++_size;
+            return true;}
+
+        /**
+         * Puts v at the front unless the ring is full; a full ring keeps its
+         * elements, since the one to drop would be the oldest, v itself.
+         * Returns whether v was added.
+         */
+        bool push_front (const_reference v) {
+            return emplace_front(v);}
+
+        /**
+         * <your documentation>
+         */
+        bool push_front (value_type&& v) {
+            return emplace_front(std::move(v));}
+
+        /**
+         * <your documentation>
+         */
+        void pop_front () {
+            assert(!empty());
+            destroy_slots(_b, _b + 1);
+            _b = advance(_b, 1);
+            --_size;}
+
+        /**
+         * Moves the front element into x and removes it.
+         * Returns false, leaving x alone, when the ring is empty.
+         */
+        bool try_pop_front (value_type& x) {
+            if (empty())
+                return false;
+            x = std::move(*slot(_b));
+            pop_front();
+            return true;}
+
+        /**
+         * Destroys every element; the blocks stay.
+         */
+        void clear () {
+            const size_type e = _b + _size;
+            if (e <= _capacity)
+                destroy_slots(_b, e);
+            else {
+                destroy_slots(_b, _capacity);
+                destroy_slots(0, e - _capacity);}
+            _b    = 0;
+            _size = 0;}
+
+        // ---------
+        // accessors
+        // ---------
+
+        /**
+         * <your documentation>
+         */
+        reference operator [] (size_type index) {
+            assert(index < size());
+            return *slot(advance(_b, index));}
+
+        /**
+         * <your documentation>
+         */
+        const_reference operator [] (size_type index) const {
+            return const_cast<ring_deque*>(this)->operator[](index);}
+
+        /**
+         * <your documentation>
+         */
+        reference front () {
+            return (*this)[0];}
+
+        /**
+         * <your documentation>
+         */
+        const_reference front () const {
+            return (*this)[0];}
+
+        /**
+         * <your documentation>
+         */
+        reference back () {
+            return (*this)[_size - 1];}
+
+        /**
+         * <your documentation>
+         */
+        const_reference back () const {
+            return (*this)[_size - 1];}
+
+        // ---------
+        // observers
+        // ---------
+
+        /**
+         * <your documentation>
+         */
+        size_type capacity () const {
+            return _capacity;}
+
+        /**
+         * <your documentation>
+         */
+        size_type size () const {
+            return _size;}
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return _size == 0;}
+
+        /**
+         * <your documentation>
+         */
+        bool full () const {
+            return _size == _capacity;}};
+
+#endif // RingDeque_h
@@ -0,0 +1,217 @@
+// --------------------------
+// projects/deque/SpscDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// --------------------------
+
+#ifndef SpscDeque_h
+#define SpscDeque_h
+
+// --------
+// includes
+// --------
+
+#include <atomic>      // atomic, memory_order
+#include <cassert>     // assert
+#include <cstddef>     // size_t
+#include <memory>      // allocator, allocator_traits
+#include <new>         // placement new
+#include <type_traits> // aligned_storage
+#include <utility>     // forward, move
+
+#include "Deque.h"
+
+// ----------
+// spsc_deque
+// ----------
+
+/**
+ * Unbounded single-producer/single-consumer queue over B-element blocks.
+ * One thread may call push_back/emplace_back while another calls
+ * try_pop_front; no locks are taken, only acquire/release atomics.
+ *
+ * The blocks are the same B-element blocks my_deque uses, but they are
+ * chained instead of being indexed through a map, because a map cannot be
+ * regrown while the other thread is reading it without a lock. Blocks the
+ * consumer has finished with are reused by the producer.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t B = deque_block_size<T>::value >
+class spsc_deque {
+    static_assert(B > 0, "spsc_deque block size must be positive");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef A                                        allocator_type;
+        typedef typename allocator_type::value_type      value_type;
+        typedef typename allocator_type::size_type       size_type;
+        typedef typename allocator_type::reference       reference;
+        typedef typename allocator_type::const_reference const_reference;
+
+    private:
+        struct block {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[B];
+            std::atomic<block*> next;
+
+            T* slot (size_type i) {
+                return reinterpret_cast<T*>(&slots[i]);}};
+
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<block> block_alloc_type;
+
+        /**
+         * Keeps the producer's and the consumer's fields on separate cache lines.
+         */
+        static const std::size_t cache_line = 64;
+
+    private:
+        // --------
+        // producer
+        // --------
+
+        alignas(cache_line) std::atomic<size_type> _e;
+        block* _tail;
+        block* _first;
+        allocator_type _a;
+        block_alloc_type _o;
+
+        // --------
+        // consumer
+        // --------
+
+        alignas(cache_line) std::atomic<size_type> _b;
+        std::atomic<block*> _head;
+
+    private:
+        /**
+         * A freshly allocated block with no successor.
+         */
+        block* new_block () {
+            block* p = ::new (static_cast<void*>(_o.allocate(1))) block;
+            p->next.store(0, std::memory_order_relaxed);
+            return p;}
+
+        /**
+         * A block for the producer: the oldest one the consumer has left
+         * behind if there is one, a new one otherwise.
+         */
+        block* acquire_block () {
+            if (_first == _head.load(std::memory_order_acquire))
+                return new_block();
+            block* p = _first;
+            _first = _first->next.load(std::memory_order_relaxed);
+            p->next.store(0, std::memory_order_relaxed);
+            return p;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * <your documentation>
+         */
+        explicit spsc_deque (const allocator_type& a = allocator_type()) :
+                _e (0),
+                _a (a),
+                _o (a),
+                _b (0) {
+            _tail = _first = new_block();
+            _head.store(_tail, std::memory_order_relaxed);}
+
+        spsc_deque (const spsc_deque&) = delete;
+        spsc_deque& operator = (const spsc_deque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Destroys what was never popped and frees every block.
+         * No other thread may be using the queue.
+         */
+        ~spsc_deque () {
+            block* p = _head.load(std::memory_order_relaxed);
+            const size_type e = _e.load(std::memory_order_relaxed);
+            for (size_type b = _b.load(std::memory_order_relaxed); b != e; ++b) {
+                if ((b % B == 0) && (b != 0))
+                    p = p->next.load(std::memory_order_relaxed);
+                std::allocator_traits<allocator_type>::destroy(_a, p->slot(b % B));}
+            p = _first;
+            while (p != 0) {
+                block* next = p->next.load(std::memory_order_relaxed);
+                p->~block();
+                _o.deallocate(p, 1);
+                p = next;}}
+
+        // --------
+        // producer
+        // --------
+
+        /**
+         * Constructs an element at the back. Producer thread only.
+         */
+        template <typename... Args>
+        void emplace_back (Args&&... args) {
+            const size_type e = _e.load(std::memory_order_relaxed);
+            if ((e % B == 0) && (e != 0)) {
+                block* p = acquire_block();
+                _tail->next.store(p, std::memory_order_release);
+                _tail = p;}
+            std::allocator_traits<allocator_type>::construct(_a, _tail->slot(e % B), std::forward<Args>(args)...);
+            _e.store(e + 1, std::memory_order_release);}
+
+        /**
+         * <your documentation>
+         */
+        void push_back (const_reference v) {
+            emplace_back(v);}
+
+        /**
+         * <your documentation>
+         */
+        void push_back (value_type&& v) {
+            emplace_back(std::move(v));}
+
+        // --------
+        // consumer
+        // --------
+
+        /**
+         * Moves the front element into x and removes it. Consumer thread only.
+         * Returns false, leaving x alone, when the queue is empty.
+         */
+        bool try_pop_front (value_type& x) {
+            const size_type b = _b.load(std::memory_order_relaxed);
+            if (b == _e.load(std::memory_order_acquire))
+                return false;
+            block* p = _head.load(std::memory_order_relaxed);
+            if ((b % B == 0) && (b != 0)) {
+                p = p->next.load(std::memory_order_acquire);
+                assert(p != 0);
+                _head.store(p, std::memory_order_release);}
+            T* slot = p->slot(b % B);
+            x = std::move(*slot);
+            std::allocator_traits<allocator_type>::destroy(_a, slot);
+            _b.store(b + 1, std::memory_order_release);
+            return true;}
+
+        // ---------
+        // observers
+        // ---------
+
+        /**
+         * Only a snapshot while the other thread is running.
+         */
+        size_type size () const {
+            const size_type b = _b.load(std::memory_order_acquire);
+            return _e.load(std::memory_order_acquire) - b;}
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return size() == 0;}};
+
+#endif // SpscDeque_h
@@ -37,16 +37,254 @@ To obtain coverage of the test:
 // includes
 // --------
 
-#include <algorithm> // equal
+// compile my_deque::stats() and its counters into the tests
+#define DEQUE_STATS
+
+#include <algorithm> // equal, sort
+#include <atomic>    // atomic
 #include <cstring>   // strcmp
 #include <deque>     // deque
-#include <sstream>   // ostringstream
+#include <iterator>  // distance, istream_iterator, iterator_traits
+#include <limits>    // numeric_limits
+#include <list>      // list
+#include <memory>    // unique_ptr
+#include <new>       // operator new
+#include <sstream>   // ostringstream, stringstream
 #include <stdexcept> // invalid_argument
 #include <string>    // ==
+#include <thread>    // thread
+
+#include <sys/uio.h> // iovec, readv, writev
+#include <unistd.h>  // close, getpid, pipe, unlink
+#include <type_traits> // is_same
+#include <utility>   // forward, move
+#include <vector>    // vector
 
 #include "gtest/gtest.h"
 
 #include "Deque.h"
+#include "ConcurrentDeque.h"
+#include "MappedDeque.h"
+#include "ParallelDeque.h"
+#include "RingDeque.h"
+#include "SpscDeque.h"
+#include "WorkStealingDeque.h"
+
+// ------------------
+// counting_allocator
+// ------------------
+
+/**
+ * std::allocator look-alike that counts calls per value type, so that
+ * block (T) and map (T*) allocations can be checked separately.
+ */
+template <typename T>
+struct counting_allocator {
+    typedef T              value_type;
+    typedef std::size_t    size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef T*             pointer;
+    typedef const T*       const_pointer;
+    typedef T&             reference;
+    typedef const T&       const_reference;
+
+    template <typename U>
+    struct rebind {
+        typedef counting_allocator<U> other;};
+
+    static std::size_t allocations;
+    static std::size_t deallocations;
+    static std::size_t live_bytes;
+
+    static std::size_t live () {
+        return allocations - deallocations;}
+
+    static void reset () {
+        allocations = deallocations = live_bytes = 0;}
+
+    counting_allocator () {}
+
+    template <typename U>
+    counting_allocator (const counting_allocator<U>&) {}
+
+    T* allocate (size_type n) {
+        ++allocations;
+        live_bytes += n * sizeof(T);
+        return static_cast<T*>(::operator new(n * sizeof(T)));}
+
+    void deallocate (T* p, size_type n) {
+        ++deallocations;
+        live_bytes -= n * sizeof(T);
+        ::operator delete(p);}
+
+    template <typename U, typename... Args>
+    void construct (U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);}
+
+    template <typename U>
+    void destroy (U* p) {
+        p->~U();}};
+
+template <typename T>
+std::size_t counting_allocator<T>::allocations = 0;
+
+template <typename T>
+std::size_t counting_allocator<T>::deallocations = 0;
+
+template <typename T>
+std::size_t counting_allocator<T>::live_bytes = 0;
+
+template <typename T, typename U>
+bool operator == (const counting_allocator<T>&, const counting_allocator<U>&) {
+    return true;}
+
+template <typename T, typename U>
+bool operator != (const counting_allocator<T>&, const counting_allocator<U>&) {
+    return false;}
+
+// ---------------
+// arena_allocator
+// ---------------
+
+/**
+ * A bump arena: allocate hands out the next aligned bytes of its buffer,
+ * deallocate only counts. Everything is freed with the arena.
+ */
+struct arena {
+    std::vector<char> buffer;
+    std::size_t       used;
+    std::size_t       allocations;
+    std::size_t       deallocations;
+
+    explicit arena (std::size_t n) :
+            buffer        (n),
+            used          (0),
+            allocations   (0),
+            deallocations (0)
+        {}
+
+    void* allocate (std::size_t n, std::size_t alignment) {
+        const std::size_t p = (used + alignment - 1) / alignment * alignment;
+        if (p + n > buffer.size())
+            throw std::bad_alloc();
+        used = p + n;
+        ++allocations;
+        return &buffer[p];}
+
+    bool owns (const void* p) const {
+        return (p >= buffer.data()) && (p < buffer.data() + buffer.size());}};
+
+/**
+ * A stateful allocator on an arena, or on the heap when it has none.
+ * P sets all three propagate_on_container_* traits; when P is false a
+ * copied container falls back to the heap, the way a pmr allocator falls
+ * back to the default resource.
+ */
+template <typename T, bool P>
+struct arena_allocator {
+    typedef T value_type;
+
+    typedef std::integral_constant<bool, P> propagate_on_container_copy_assignment;
+    typedef std::integral_constant<bool, P> propagate_on_container_move_assignment;
+    typedef std::integral_constant<bool, P> propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef arena_allocator<U, P> other;};
+
+    arena* _arena;
+
+    arena_allocator () :
+            _arena (0)
+        {}
+
+    explicit arena_allocator (arena& a) :
+            _arena (&a)
+        {}
+
+    template <typename U>
+    arena_allocator (const arena_allocator<U, P>& that) :
+            _arena (that._arena)
+        {}
+
+    T* allocate (std::size_t n) {
+        if (_arena == 0)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));}
+
+    void deallocate (T* p, std::size_t) {
+        if (_arena == 0)
+            ::operator delete(p);
+        else
+            ++_arena->deallocations;}
+
+    arena_allocator select_on_container_copy_construction () const {
+        return P ? *this : arena_allocator();}};
+
+template <typename T, typename U, bool P>
+bool operator == (const arena_allocator<T, P>& lhs, const arena_allocator<U, P>& rhs) {
+    return lhs._arena == rhs._arena;}
+
+template <typename T, typename U, bool P>
+bool operator != (const arena_allocator<T, P>& lhs, const arena_allocator<U, P>& rhs) {
+    return !(lhs == rhs);}
+
+// -------------
+// move_counter
+// -------------
+
+/**
+ * An int that counts how often it is moved or copied.
+ */
+struct move_counter {
+    static std::size_t moves;
+
+    int value;
+
+    move_counter (int v = 0) :
+            value (v)
+        {}
+
+    move_counter (const move_counter& that) :
+            value (that.value) {
+        ++moves;}
+
+    move_counter& operator = (const move_counter& that) {
+        value = that.value;
+        ++moves;
+        return *this;}};
+
+std::size_t move_counter::moves = 0;
+
+// -------------
+// life_counter
+// -------------
+
+/**
+ * Counts constructions and destructions, to check that the
+ * non-trivial paths still construct and destroy every element.
+ */
+struct life_counter {
+    static int alive;
+
+    int value;
+
+    life_counter (int v = 0) :
+            value (v) {
+        ++alive;}
+
+    life_counter (const life_counter& that) :
+            value (that.value) {
+        ++alive;}
+
+    life_counter& operator = (const life_counter& that) {
+        value = that.value;
+        return *this;}
+
+    ~life_counter () {
+        --alive;}};
+
+int life_counter::alive = 0;
 
 // ---------
 // TestDeque
@@ -87,7 +325,11 @@ typedef testing::Types<
             std::deque<int>,
             std::deque<double>,
             my_deque<int>,
-            my_deque<double> >
+            my_deque<double>,
+            my_deque<int, std::allocator<int>, 3>,
+            my_deque<double, std::allocator<double>, 1>,
+            my_deque<int, std::allocator<int>, 16, 8>,
+            my_deque<double, std::allocator<double>, 4, 3> >
         my_types;
 
 TYPED_TEST_CASE(TestDeque, my_types);
@@ -1785,4 +2027,2008 @@ TYPED_TEST(TestDeque, erase_6)
     x.erase(x.begin());
     x.erase(x.begin());
     ASSERT_EQ(*x.begin(), 1);
-}
\ No newline at end of file
+}
+TYPED_TEST(TestDeque, iterator_random_access_1)
+{
+    NAMES
+    typedef typename TestFixture::iterator iterator;
+    ASSERT_TRUE((std::is_same<typename std::iterator_traits<iterator>::iterator_category,
+                              std::random_access_iterator_tag>::value));
+    deque_type x;
+    for (int i = 0; i < 50; ++i)
+        x.push_front(i);
+    iterator b = x.begin();
+    iterator e = x.end();
+    ASSERT_EQ(50, e - b);
+    ASSERT_EQ(50, std::distance(b, e));
+    ASSERT_TRUE(b < e);
+    ASSERT_TRUE(e > b);
+    ASSERT_TRUE(b <= b);
+    ASSERT_EQ(49, b[0]);
+    ASSERT_EQ(10, b[39]);
+    ASSERT_EQ(0, *(e - 1));
+    ASSERT_EQ(e, (b + 37) + 13);
+    ASSERT_EQ(b, (e - 37) - 13);
+}
+
+TYPED_TEST(TestDeque, iterator_random_access_2)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 100; ++i)
+        x.push_back((i * 37) % 100);
+    std::sort(x.begin(), x.end());
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(i, x[i]);
+    ASSERT_EQ(42, std::lower_bound(x.begin(), x.end(), 42) - x.begin());
+}
+
+TYPED_TEST(TestDeque, iterator_random_access_3)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 30; ++i)
+        x.push_back(i);
+    const deque_type a(x);
+    typename deque_type::const_iterator b = a.begin();
+    typename deque_type::const_iterator e = a.end();
+    ASSERT_EQ(30, e - b);
+    for (int i = 0; i < 30; ++i)
+        ASSERT_EQ(i, b[i]);
+    typename deque_type::const_iterator c = x.begin();
+    ASSERT_TRUE(c == x.begin());
+    int n = 29;
+    while (e != b)
+        ASSERT_EQ(n--, *--e);
+}
+
+TYPED_TEST(TestDeque, segmented_copy)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 40; ++i)
+        x.push_back(i);
+    x.pop_front();
+    std::vector<int> v(38);
+    copy(x.begin(), x.end() - 1, v.begin());
+    for (int i = 0; i < 38; ++i)
+        ASSERT_EQ(i + 1, v[i]);
+}
+
+TYPED_TEST(TestDeque, segmented_fill)
+{
+    NAMES
+    deque_type x(25, 1);
+    fill(x.begin() + 3, x.end() - 2, 7);
+    ASSERT_EQ(1, x[2]);
+    ASSERT_EQ(7, x[3]);
+    ASSERT_EQ(7, x[22]);
+    ASSERT_EQ(1, x[23]);
+}
+
+TYPED_TEST(TestDeque, segmented_for_each_accumulate)
+{
+    NAMES
+    deque_type x;
+    for (int i = 1; i <= 30; ++i)
+        x.push_front(i);
+    int sum = 0;
+    for_each(x.begin(), x.end(), [&sum] (value_type v) {sum += v;});
+    ASSERT_EQ(465, sum);
+    ASSERT_EQ(465, accumulate(x.begin(), x.end(), 0));
+    ASSERT_EQ(465 - 30 - 1, accumulate(x.begin() + 1, x.end() - 1, 0));
+    ASSERT_EQ(30, accumulate(x.begin(), x.end(), 0, [] (int a, value_type) {return a + 1;}));
+}
+
+TYPED_TEST(TestDeque, segmented_find_count)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 30; ++i)
+        x.push_back(i % 7);
+    ASSERT_EQ(x.begin() + 5, find(x.begin(), x.end(), 5));
+    ASSERT_EQ(x.begin() + 12, find(x.begin() + 6, x.end(), 5));
+    ASSERT_EQ(x.end(), find(x.begin(), x.end(), 9));
+    ASSERT_EQ(x.begin() + 20, find(x.begin() + 20, x.begin() + 20, 6));
+    ASSERT_EQ(5, count(x.begin(), x.end(), 0));
+    ASSERT_EQ(4, count(x.begin(), x.end(), 6));
+    const deque_type a(x);
+    ASSERT_EQ(a.begin() + 3, find(a.begin(), a.end(), 3));
+    ASSERT_EQ(0, count(a.begin(), a.end(), 9));
+}
+
+TEST(TestSegments, for_each_segment)
+{
+    typedef my_deque<int, std::allocator<int>, 4> deque_type;
+    deque_type x;
+    for (int i = 0; i < 10; ++i)
+        x.push_back(i);
+    x.pop_front();
+    std::vector<std::ptrdiff_t> lengths;
+    int expected = 1;
+    for_each_segment(x.begin(), x.end(), [&] (int* b, int* e) {
+        lengths.push_back(e - b);
+        for (; b != e; ++b)
+            ASSERT_EQ(expected++, *b);});
+    ASSERT_EQ(10, expected);
+    std::ptrdiff_t total = 0;
+    for (std::size_t i = 0; i != lengths.size(); ++i) {
+        ASSERT_LE(lengths[i], 4);
+        total += lengths[i];}
+    ASSERT_EQ(9, total);
+    ASSERT_GE(lengths.size(), 3u);
+}
+
+TEST(TestAllocation, push_back_allocates_only_reached_blocks)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i < 1000; ++i)
+            x.push_back(i);
+        ASSERT_EQ(63u, counting_allocator<int>::allocations);
+        ASSERT_LE(counting_allocator<int*>::allocations, 8u);
+        for (int i = 0; i < 1000; ++i)
+            ASSERT_EQ(i, x[i]);
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+    ASSERT_EQ(0u, counting_allocator<int*>::live());
+}
+
+TEST(TestAllocation, push_front_allocates_only_reached_blocks)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i < 1000; ++i)
+            x.push_front(i);
+        ASSERT_EQ(63u, counting_allocator<int>::allocations);
+        x.resize(1016, 5);
+        ASSERT_EQ(64u, counting_allocator<int>::allocations);
+        ASSERT_EQ(999, x.front());
+        ASSERT_EQ(5, x.back());
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+}
+
+TEST(TestAllocation, fifo_recenters_map_in_place)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    deque_type x;
+    for (int i = 0; i < 20; ++i)
+        x.push_back(i);
+    for (int i = 20; i < 1000; ++i) {
+        x.push_back(i);
+        x.pop_front();}
+    const std::size_t blocks = counting_allocator<int>::allocations;
+    const std::size_t maps   = counting_allocator<int*>::allocations;
+    for (int i = 1000; i < 100000; ++i) {
+        x.push_back(i);
+        x.pop_front();}
+    ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    ASSERT_EQ(maps,   counting_allocator<int*>::allocations);
+    ASSERT_EQ(20u, x.size());
+    ASSERT_EQ(99980, x.front());
+    ASSERT_EQ(99999, x.back());
+}
+
+TEST(TestAllocation, fifo_recycles_spare_blocks)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    deque_type x;
+    for (int i = 0; i < 40; ++i)
+        x.push_back(i);
+    for (int i = 40; i < 1000; ++i) {
+        x.push_back(i);
+        x.pop_front();}
+    const std::size_t blocks = counting_allocator<int>::allocations;
+    ASSERT_LE(blocks, 4u);
+    for (int i = 1000; i < 100000; ++i) {
+        x.push_back(i);
+        x.pop_front();}
+    ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    ASSERT_LE(counting_allocator<int>::live(), 4u + deque_type::spare_limit);
+}
+
+TEST(TestAllocation, pop_releases_blocks_to_bounded_spares)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i < 1600; ++i)
+            x.push_back(i);
+        ASSERT_EQ(100u, counting_allocator<int>::live());
+        for (int i = 0; i < 800; ++i)
+            x.pop_front();
+        for (int i = 0; i < 799; ++i)
+            x.pop_back();
+        ASSERT_EQ(1u, x.size());
+        ASSERT_EQ(800, x.front());
+        ASSERT_LE(counting_allocator<int>::live(), 2u + deque_type::spare_limit);
+        const std::size_t blocks = counting_allocator<int>::allocations;
+        for (int i = 0; i < 16 * static_cast<int>(deque_type::spare_limit); ++i)
+            x.push_back(i);
+        ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+}
+
+TEST(TestAllocation, clear_and_shrink_to_fit)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    deque_type x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_front(i);
+    x.clear();
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(deque_type::spare_limit, counting_allocator<int>::live());
+    x.shrink_to_fit();
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+    ASSERT_EQ(0u, counting_allocator<int*>::live());
+    for (int i = 0; i < 100; ++i)
+        x.push_back(i);
+    x.resize(40);
+    x.shrink_to_fit();
+    ASSERT_EQ(3u, counting_allocator<int>::live());
+    ASSERT_EQ(1u, counting_allocator<int*>::live());
+    for (int i = 0; i < 40; ++i)
+        ASSERT_EQ(i, x[i]);
+    x.push_front(-1);
+    x.push_back(40);
+    ASSERT_EQ(-1, x.front());
+    ASSERT_EQ(40, x.back());
+}
+
+TEST(TestMove, move_constructor_steals_storage)
+{
+    typedef my_deque<std::string, std::allocator<std::string>, 3> deque_type;
+    deque_type x;
+    for (int i = 0; i < 10; ++i)
+        x.push_back(std::string(20, 'a' + i));
+    const std::string* first = &x[0];
+    deque_type y(std::move(x));
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(10u, y.size());
+    ASSERT_EQ(first, &y[0]);
+    ASSERT_EQ(std::string(20, 'j'), y.back());
+    x.push_back("reused");
+    ASSERT_EQ("reused", x.front());
+}
+
+TEST(TestMove, move_assignment_steals_storage)
+{
+    typedef my_deque<std::string, std::allocator<std::string>, 3> deque_type;
+    deque_type x;
+    deque_type y;
+    for (int i = 0; i < 10; ++i) {
+        x.push_front(std::string(20, 'a' + i));
+        y.push_back("old");}
+    const std::string* first = &x[0];
+    y = std::move(x);
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(first, &y[0]);
+    ASSERT_EQ(std::string(20, 'a'), y.back());
+    y = std::move(y);
+    ASSERT_EQ(10u, y.size());
+}
+
+TEST(TestMove, emplace_and_rvalue_push)
+{
+    typedef my_deque<std::string, std::allocator<std::string>, 3> deque_type;
+    deque_type x;
+    x.emplace_back(3, 'b');
+    x.emplace_front(2, 'a');
+    std::string s(30, 'c');
+    x.push_back(std::move(s));
+    ASSERT_TRUE(s.empty());
+    std::string t(30, 'z');
+    x.push_front(std::move(t));
+    ASSERT_TRUE(t.empty());
+    x.emplace(x.begin() + 2, 4, 'm');
+    ASSERT_EQ(5u, x.size());
+    ASSERT_EQ(std::string(30, 'z'), x[0]);
+    ASSERT_EQ("aa", x[1]);
+    ASSERT_EQ("mmmm", x[2]);
+    ASSERT_EQ("bbb", x[3]);
+    ASSERT_EQ(std::string(30, 'c'), x[4]);
+    x.insert(x.end(), std::string("end"));
+    ASSERT_EQ("end", x.back());
+}
+
+TEST(TestMove, move_only_elements)
+{
+    typedef my_deque<std::unique_ptr<int>, std::allocator<std::unique_ptr<int> >, 2> deque_type;
+    deque_type x;
+    for (int i = 0; i < 7; ++i) {
+        x.push_back(std::unique_ptr<int>(new int(i)));
+        x.emplace_front(new int(-i));}
+    deque_type y(std::move(x));
+    ASSERT_EQ(14u, y.size());
+    ASSERT_EQ(-6, *y.front());
+    ASSERT_EQ(6, *y.back());
+    y.pop_front();
+    y.pop_back();
+    deque_type z;
+    z = std::move(y);
+    ASSERT_EQ(12u, z.size());
+}
+
+TEST(TestMove, swap_is_constant_time)
+{
+    typedef my_deque<std::string, counting_allocator<std::string>, 3> deque_type;
+    deque_type x;
+    deque_type y;
+    for (int i = 0; i < 10; ++i) {
+        x.push_back("x");
+        y.push_back("y");}
+    y.push_back("y");
+    const std::string* px = &x[0];
+    const std::string* py = &y[0];
+    const std::size_t allocations = counting_allocator<std::string>::allocations;
+    swap(x, y);
+    ASSERT_EQ(allocations, counting_allocator<std::string>::allocations);
+    ASSERT_EQ(py, &x[0]);
+    ASSERT_EQ(px, &y[0]);
+    ASSERT_EQ(11u, x.size());
+    ASSERT_EQ(10u, y.size());
+}
+
+TEST(TestMove, vector_of_deques_moves)
+{
+    typedef my_deque<std::string, std::allocator<std::string>, 3> deque_type;
+    std::vector<deque_type> v;
+    v.push_back(deque_type());
+    v[0].push_back("payload");
+    const std::string* p = &v[0][0];
+    for (int i = 0; i < 100; ++i)
+        v.push_back(deque_type());
+    ASSERT_EQ(p, &v[0][0]);
+    ASSERT_EQ("payload", v[0][0]);
+}
+
+TYPED_TEST(TestDeque, range_constructor)
+{
+    NAMES
+    std::vector<int> v;
+    for (int i = 0; i < 50; ++i)
+        v.push_back(i);
+    deque_type x(v.begin(), v.end());
+    ASSERT_EQ(50u, x.size());
+    ASSERT_TRUE(std::equal(v.begin(), v.end(), x.begin()));
+    deque_type y(x.begin() + 10, x.end() - 10);
+    ASSERT_EQ(30u, y.size());
+    ASSERT_EQ(10, y.front());
+    ASSERT_EQ(39, y.back());
+    std::list<int> l(v.begin(), v.end());
+    deque_type z(l.begin(), l.end());
+    ASSERT_TRUE(z == x);
+}
+
+TYPED_TEST(TestDeque, input_range_constructor)
+{
+    NAMES
+    std::istringstream in("1 2 3 4 5 6 7");
+    deque_type x((std::istream_iterator<int>(in)), std::istream_iterator<int>());
+    ASSERT_EQ(7u, x.size());
+    ASSERT_EQ(1, x.front());
+    ASSERT_EQ(7, x.back());
+}
+
+TYPED_TEST(TestDeque, initializer_list)
+{
+    NAMES
+    deque_type x = {1, 2, 3, 4, 5};
+    ASSERT_EQ(5u, x.size());
+    ASSERT_EQ(3, x[2]);
+    x = {9, 8};
+    ASSERT_EQ(2u, x.size());
+    ASSERT_EQ(8, x.back());
+    x.insert(x.begin() + 1, {7, 6, 5});
+    deque_type y = {9, 7, 6, 5, 8};
+    ASSERT_TRUE(x == y);
+}
+
+TYPED_TEST(TestDeque, assign)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 40; ++i)
+        x.push_front(i);
+    std::vector<int> v(10, 3);
+    x.assign(v.begin(), v.end());
+    ASSERT_EQ(10u, x.size());
+    ASSERT_EQ(3, x.front());
+    ASSERT_EQ(3, x.back());
+    x.assign(25, 4);
+    ASSERT_EQ(25u, x.size());
+    ASSERT_EQ(4, x[24]);
+    x.assign({1, 2});
+    ASSERT_EQ(2u, x.size());
+    ASSERT_EQ(2, x.back());
+    deque_type y(60, 5);
+    x = y;
+    ASSERT_TRUE(x == y);
+}
+
+TYPED_TEST(TestDeque, insert_range)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 20; ++i)
+        x.push_back(i);
+    std::vector<int> v;
+    for (int i = 100; i < 130; ++i)
+        v.push_back(i);
+    x.insert(x.begin() + 5, v.begin(), v.end());
+    ASSERT_EQ(50u, x.size());
+    ASSERT_EQ(4, x[4]);
+    ASSERT_EQ(100, x[5]);
+    ASSERT_EQ(129, x[34]);
+    ASSERT_EQ(5, x[35]);
+    x.insert(x.end(), 3, -1);
+    ASSERT_EQ(53u, x.size());
+    ASSERT_EQ(-1, x[50]);
+    ASSERT_EQ(19, x[49]);
+    x.insert(x.begin(), 2, -2);
+    ASSERT_EQ(-2, x[1]);
+    ASSERT_EQ(0, x[2]);
+}
+
+TEST(TestAllocation, range_construction_grows_once)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    std::vector<int> v(100000);
+    for (int i = 0; i < 100000; ++i)
+        v[i] = i;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    deque_type x(v.begin(), v.end());
+    ASSERT_EQ(6250u, counting_allocator<int>::allocations);
+    ASSERT_EQ(1u, counting_allocator<int*>::allocations);
+    deque_type y(x);
+    ASSERT_EQ(12500u, counting_allocator<int>::allocations);
+    ASSERT_EQ(2u, counting_allocator<int*>::allocations);
+    ASSERT_TRUE(x == y);
+    y.assign(v.begin(), v.begin() + 50000);
+    ASSERT_EQ(12500u, counting_allocator<int>::allocations);
+    ASSERT_EQ(2u, counting_allocator<int*>::allocations);
+    ASSERT_EQ(49999, y.back());
+}
+
+TYPED_TEST(TestDeque, erase_range)
+{
+    NAMES
+    deque_type x;
+    for (int i = 0; i < 60; ++i)
+        x.push_back(i);
+    ASSERT_EQ(x.begin() + 5, x.erase(x.begin() + 5, x.begin() + 15));
+    ASSERT_EQ(50u, x.size());
+    ASSERT_EQ(4, x[4]);
+    ASSERT_EQ(15, x[5]);
+    ASSERT_EQ(x.begin() + 40, x.erase(x.begin() + 40, x.begin() + 48));
+    ASSERT_EQ(42u, x.size());
+    ASSERT_EQ(49, x[39]);
+    ASSERT_EQ(58, x[40]);
+    ASSERT_EQ(x.end(), x.erase(x.begin(), x.end()));
+    ASSERT_TRUE(x.empty());
+    x.push_back(1);
+    ASSERT_EQ(x.begin(), x.erase(x.begin(), x.begin()));
+    ASSERT_EQ(1u, x.size());
+}
+
+TYPED_TEST(TestDeque, insert_erase_both_halves)
+{
+    NAMES
+    deque_type x;
+    deque_type y;
+    for (int i = 0; i < 100; ++i) {
+        x.push_back(i);
+        y.push_back(i);}
+    for (int i = 0; i < 100; i += 7) {
+        x.insert(x.begin() + i, -i);
+        x.erase(x.begin() + i + 1);
+        y[i] = -i;}
+    ASSERT_TRUE(x == y);
+    x.insert(x.begin() + 3, y.begin(), y.begin() + 10);
+    x.insert(x.begin() + 100, y.begin(), y.begin() + 10);
+    ASSERT_EQ(120u, x.size());
+    ASSERT_EQ(y[0], x[3]);
+    ASSERT_EQ(y[9], x[12]);
+    ASSERT_EQ(y[2], x[2]);
+    ASSERT_EQ(y[3], x[13]);
+    ASSERT_EQ(y[0], x[100]);
+    ASSERT_EQ(y.back(), x.back());
+}
+
+TEST(TestShift, insert_and_erase_move_the_shorter_side)
+{
+    typedef my_deque<move_counter, std::allocator<move_counter>, 16> deque_type;
+    deque_type x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_back(move_counter(i));
+
+    move_counter::moves = 0;
+    x.insert(x.begin() + 3, move_counter(-1));
+    ASSERT_LE(move_counter::moves, 8u);
+    ASSERT_EQ(-1, x[3].value);
+    ASSERT_EQ(3, x[4].value);
+
+    move_counter::moves = 0;
+    x.insert(x.end() - 3, move_counter(-2));
+    ASSERT_LE(move_counter::moves, 8u);
+    ASSERT_EQ(-2, x[998].value);
+
+    move_counter::moves = 0;
+    x.erase(x.begin() + 2);
+    ASSERT_LE(move_counter::moves, 4u);
+    ASSERT_EQ(-1, x[2].value);
+
+    move_counter::moves = 0;
+    x.erase(x.end() - 2);
+    ASSERT_LE(move_counter::moves, 4u);
+
+    move_counter::moves = 0;
+    x.erase(x.begin() + 1, x.begin() + 11);
+    ASSERT_LE(move_counter::moves, 4u);
+    ASSERT_EQ(0, x[0].value);
+    ASSERT_EQ(11, x[1].value);
+
+    std::vector<move_counter> v(5, move_counter(7));
+    move_counter::moves = 0;
+    x.insert(x.begin() + 2, v.begin(), v.end());
+    ASSERT_LE(move_counter::moves, 40u);
+    ASSERT_EQ(7, x[2].value);
+    ASSERT_EQ(12, x[7].value);
+}
+
+TEST(TestTrivial, construction_traits)
+{
+    ASSERT_TRUE((trivially_copied<std::allocator<int>, int>::value));
+    ASSERT_TRUE((trivially_destroyed<std::allocator<double>, double>::value));
+    ASSERT_FALSE((trivially_copied<counting_allocator<int>, int>::value));
+    ASSERT_FALSE((trivially_destroyed<counting_allocator<int>, int>::value));
+    ASSERT_FALSE((trivially_copied<std::allocator<std::string>, std::string>::value));
+    ASSERT_FALSE((trivially_destroyed<std::allocator<life_counter>, life_counter>::value));
+}
+
+TEST(TestTrivial, trivial_helpers)
+{
+    std::allocator<int> a;
+    int src[5] = {1, 2, 3, 4, 5};
+    int dst[5] = {0, 0, 0, 0, 0};
+    ASSERT_EQ(dst + 5, uninitialized_copy(a, src, src + 5, dst));
+    ASSERT_TRUE(std::equal(src, src + 5, dst));
+    ASSERT_EQ(dst + 3, uninitialized_fill(a, dst, dst + 3, 9));
+    ASSERT_EQ(9, dst[2]);
+    ASSERT_EQ(4, dst[3]);
+    ASSERT_EQ(dst, destroy(a, dst, dst + 5));
+    std::allocator<double> d;
+    double ds[5];
+    ASSERT_EQ(ds + 5, uninitialized_copy(d, src, src + 5, ds));
+    ASSERT_EQ(5.0, ds[4]);
+}
+
+TEST(TestTrivial, non_trivial_elements_are_destroyed)
+{
+    typedef my_deque<life_counter, std::allocator<life_counter>, 4> deque_type;
+    life_counter::alive = 0;
+    {
+        deque_type x(10, life_counter(1));
+        ASSERT_EQ(10, life_counter::alive);
+        x.pop_front();
+        x.pop_back();
+        ASSERT_EQ(8, life_counter::alive);
+        deque_type y(x);
+        ASSERT_EQ(16, life_counter::alive);
+        y.resize(3);
+        ASSERT_EQ(11, life_counter::alive);
+        x.clear();
+        ASSERT_EQ(3, life_counter::alive);
+        x.resize(5);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+}
+
+TEST(TestSpscDeque, single_thread)
+{
+    spsc_deque<int, std::allocator<int>, 4> x;
+    int v = -1;
+    ASSERT_TRUE(x.empty());
+    ASSERT_FALSE(x.try_pop_front(v));
+    ASSERT_EQ(-1, v);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 25; ++i)
+            x.push_back(i);
+        ASSERT_EQ(25u, x.size());
+        for (int i = 0; i < 25; ++i) {
+            ASSERT_TRUE(x.try_pop_front(v));
+            ASSERT_EQ(i, v);}
+        ASSERT_TRUE(x.empty());}
+}
+
+TEST(TestSpscDeque, destroys_leftovers)
+{
+    life_counter::alive = 0;
+    {
+        spsc_deque<life_counter, std::allocator<life_counter>, 3> x;
+        for (int i = 0; i < 10; ++i)
+            x.emplace_back(i);
+        life_counter v;
+        ASSERT_TRUE(x.try_pop_front(v));
+        ASSERT_TRUE(x.try_pop_front(v));
+        ASSERT_EQ(1, v.value);
+        ASSERT_EQ(9, life_counter::alive);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+}
+
+TEST(TestSpscDeque, two_threads)
+{
+    typedef spsc_deque<std::size_t, std::allocator<std::size_t>, 64> queue_type;
+    const std::size_t n = 1000000;
+    queue_type x;
+    std::thread producer([&x, n] () {
+        for (std::size_t i = 0; i != n; ++i)
+            x.push_back(i);});
+    std::size_t expected = 0;
+    std::size_t v;
+    while (expected != n) {
+        if (x.try_pop_front(v)) {
+            ASSERT_EQ(expected, v);
+            ++expected;}
+        else
+            std::this_thread::yield();}
+    producer.join();
+    ASSERT_TRUE(x.empty());
+}
+
+TEST(TestSpscDeque, two_threads_strings)
+{
+    typedef spsc_deque<std::string, std::allocator<std::string>, 5> queue_type;
+    const int n = 100000;
+    queue_type x;
+    std::thread producer([&x, n] () {
+        for (int i = 0; i != n; ++i)
+            x.push_back(std::to_string(i));});
+    std::string v;
+    for (int expected = 0; expected != n; ) {
+        if (x.try_pop_front(v)) {
+            ASSERT_EQ(std::to_string(expected), v);
+            ++expected;}
+        else
+            std::this_thread::yield();}
+    producer.join();
+}
+
+TEST(TestWorkStealingDeque, owner_is_lifo)
+{
+    work_stealing_deque<int, std::allocator<int>, 3> x;
+    int v = -1;
+    ASSERT_TRUE(x.empty());
+    ASSERT_FALSE(x.pop_back(v));
+    ASSERT_EQ(-1, v);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 50; ++i)
+            x.push_back(i);
+        ASSERT_EQ(50u, x.size());
+        for (int i = 49; i >= 0; --i) {
+            ASSERT_TRUE(x.pop_back(v));
+            ASSERT_EQ(i, v);}
+        ASSERT_FALSE(x.pop_back(v));
+        ASSERT_TRUE(x.empty());}
+}
+
+TEST(TestWorkStealingDeque, steal_is_fifo)
+{
+    work_stealing_deque<int, std::allocator<int>, 2> x;
+    int v = -1;
+    ASSERT_FALSE(x.steal(v));
+    for (int i = 0; i < 5; ++i)
+        x.push_back(i);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(x.steal(v));
+        ASSERT_EQ(i, v);}
+    for (int i = 5; i < 40; ++i)
+        x.push_back(i);
+    ASSERT_EQ(37u, x.size());
+    ASSERT_TRUE(x.pop_back(v));
+    ASSERT_EQ(39, v);
+    for (int i = 3; i < 39; ++i) {
+        ASSERT_TRUE(x.steal(v));
+        ASSERT_EQ(i, v);}
+    ASSERT_FALSE(x.steal(v));
+    ASSERT_FALSE(x.pop_back(v));
+}
+
+TEST(TestWorkStealingDeque, releases_every_block)
+{
+    typedef work_stealing_deque<int, counting_allocator<int>, 4> deque_type;
+    typedef std::atomic<int> slot_type;
+    counting_allocator<slot_type>::reset();
+    counting_allocator<slot_type*>::reset();
+    {
+        deque_type x;
+        int v;
+        for (int i = 0; i < 1000; ++i) {
+            x.push_back(i);
+            if (i % 3 == 0)
+                x.steal(v);}
+        ASSERT_EQ(256u, counting_allocator<slot_type>::allocations);
+    }
+    ASSERT_EQ(0u, counting_allocator<slot_type>::live());
+    ASSERT_EQ(0u, counting_allocator<slot_type*>::live());
+}
+
+TEST(TestWorkStealingDeque, owner_and_thieves)
+{
+    typedef work_stealing_deque<int, std::allocator<int>, 8> deque_type;
+    const int n       = 200000;
+    const int thieves = 3;
+    deque_type x;
+    std::atomic<bool> done(false);
+    std::vector<std::vector<int>> taken(thieves + 1);
+    std::vector<std::thread> threads;
+    for (int k = 0; k < thieves; ++k)
+        threads.push_back(std::thread([&x, &done, &taken, k] () {
+            int v;
+            while (!done.load() || !x.empty())
+                if (x.steal(v))
+                    taken[k].push_back(v);
+                else
+                    std::this_thread::yield();}));
+    int v;
+    for (int i = 0; i < n; ++i) {
+        x.push_back(i);
+        if ((i % 5 == 0) && x.pop_back(v))
+            taken[thieves].push_back(v);}
+    while (x.pop_back(v))
+        taken[thieves].push_back(v);
+    done.store(true);
+    for (std::thread& t : threads)
+        t.join();
+    std::vector<int> all;
+    for (const std::vector<int>& t : taken)
+        all.insert(all.end(), t.begin(), t.end());
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(static_cast<std::size_t>(n), all.size());
+    for (int i = 0; i < n; ++i)
+        ASSERT_EQ(i, all[i]);
+}
+
+TEST(TestConcurrentDeque, single_thread)
+{
+    concurrent_deque<int, std::allocator<int>, 3> x;
+    int v = -1;
+    ASSERT_TRUE(x.empty());
+    ASSERT_FALSE(x.try_pop_front(v));
+    ASSERT_FALSE(x.try_pop_back(v));
+    ASSERT_EQ(-1, v);
+    for (int i = 0; i < 100; ++i) {
+        x.push_back(i);
+        x.push_front(-i);}
+    ASSERT_EQ(200u, x.size());
+    for (int i = 99; i >= 0; --i) {
+        ASSERT_TRUE(x.try_pop_front(v));
+        ASSERT_EQ(-i, v);
+        ASSERT_TRUE(x.try_pop_back(v));
+        ASSERT_EQ(i, v);}
+    ASSERT_TRUE(x.empty());
+    ASSERT_FALSE(x.try_pop_back(v));
+}
+
+TEST(TestConcurrentDeque, batches)
+{
+    concurrent_deque<int, std::allocator<int>, 4> x;
+    std::vector<int> v(50);
+    for (int i = 0; i < 50; ++i)
+        v[i] = i;
+    x.push_back_n(v.begin(), 50);
+    x.push_back_n(v.begin(), 0);
+    x.push_back_n(v.begin(), 50);
+    ASSERT_EQ(100u, x.size());
+    std::vector<int> out;
+    ASSERT_EQ(30u, x.pop_front_n(std::back_inserter(out), 30));
+    ASSERT_EQ(70u, x.pop_front_n(std::back_inserter(out), 1000));
+    ASSERT_EQ(0u, x.pop_front_n(std::back_inserter(out), 10));
+    ASSERT_EQ(100u, out.size());
+    ASSERT_TRUE(std::equal(v.begin(), v.end(), out.begin()));
+    ASSERT_TRUE(std::equal(v.begin(), v.end(), out.begin() + 50));
+}
+
+TEST(TestConcurrentDeque, releases_everything)
+{
+    typedef concurrent_deque<life_counter, counting_allocator<life_counter>, 4> deque_type;
+    counting_allocator<life_counter>::reset();
+    life_counter::alive = 0;
+    {
+        deque_type x;
+        life_counter v;
+        for (int i = 0; i < 1000; ++i) {
+            x.emplace_back(i);
+            x.emplace_front(-i);
+            if (i % 2 == 0) {
+                ASSERT_TRUE(x.try_pop_back(v));
+                ASSERT_EQ(i, v.value);}}
+        ASSERT_EQ(1501, life_counter::alive);
+        ASSERT_LE(counting_allocator<life_counter>::live(), 1500u / 4 + 4);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+    ASSERT_EQ(0u, counting_allocator<life_counter>::live());
+}
+
+TEST(TestConcurrentDeque, producers_and_consumers)
+{
+    typedef concurrent_deque<int, std::allocator<int>, 16> deque_type;
+    const int per_thread = 50000;
+    const int producers  = 4;
+    const int consumers  = 4;
+    deque_type x;
+    std::atomic<int> remaining(producers * per_thread);
+    std::vector<std::vector<int>> taken(consumers);
+    std::vector<std::thread> threads;
+    for (int k = 0; k < producers; ++k)
+        threads.push_back(std::thread([&x, k] () {
+            for (int i = k * per_thread; i != (k + 1) * per_thread; ++i)
+                if (k % 2 == 0)
+                    x.push_back(i);
+                else
+                    x.push_front(i);}));
+    for (int k = 0; k < consumers; ++k)
+        threads.push_back(std::thread([&x, &remaining, &taken, k] () {
+            int v;
+            while (remaining.load() > 0)
+                if ((k % 2 == 0) ? x.try_pop_front(v) : x.try_pop_back(v)) {
+                    taken[k].push_back(v);
+                    --remaining;}
+                else
+                    std::this_thread::yield();}));
+    for (std::thread& t : threads)
+        t.join();
+    ASSERT_TRUE(x.empty());
+    std::vector<int> all;
+    for (const std::vector<int>& t : taken)
+        all.insert(all.end(), t.begin(), t.end());
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(static_cast<std::size_t>(producers * per_thread), all.size());
+    for (int i = 0; i < producers * per_thread; ++i)
+        ASSERT_EQ(i, all[i]);
+}
+
+TEST(TestParallel, split_on_blocks)
+{
+    typedef my_deque<int, std::allocator<int>, 4> deque_type;
+    typedef deque_type::iterator iterator;
+    deque_type x;
+    for (int i = 0; i < 30; ++i)
+        x.push_back(i);
+    x.pop_front();
+    const std::vector<iterator> cuts = split_on_blocks(x.begin() + 2, x.end() - 1, 3);
+    ASSERT_EQ(4u, cuts.size());
+    ASSERT_EQ(x.begin() + 2, cuts.front());
+    ASSERT_EQ(x.end() - 1, cuts.back());
+    for (std::size_t i = 1; i + 1 < cuts.size(); ++i)
+        ASSERT_EQ(0, *cuts[i] % 4);
+    ASSERT_EQ(1u, split_on_blocks(x.begin(), x.begin(), 8).size());
+    ASSERT_EQ(2u, split_on_blocks(x.begin(), x.begin() + 2, 8).size());
+}
+
+TEST(TestParallel, for_each_transform)
+{
+    typedef my_deque<int, std::allocator<int>, 3> deque_type;
+    deque_type x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_front(i);
+    for (std::size_t threads = 1; threads <= 8; ++threads) {
+        deque_type y(x);
+        parallel_for_each(y.begin() + 1, y.end(), [] (int& v) {v *= 2;}, threads);
+        ASSERT_EQ(x[0], y[0]);
+        for (int i = 1; i < 1000; ++i)
+            ASSERT_EQ(2 * x[i], y[i]);
+        const deque_type& cx = x;
+        std::vector<long> v(999);
+        ASSERT_EQ(v.end(), parallel_transform(cx.begin(), cx.end() - 1, v.begin(), [] (int a) {return a + 1L;}, threads));
+        for (int i = 0; i < 999; ++i)
+            ASSERT_EQ(x[i] + 1L, v[i]);}
+}
+
+TEST(TestParallel, reduce)
+{
+    my_deque<long> x;
+    for (long i = 0; i < 100000; ++i)
+        x.push_back(i * 7 % 1000);
+    const long sum = accumulate(x.begin(), x.end(), 5L);
+    ASSERT_EQ(sum, parallel_reduce(x.begin(), x.end(), 5L));
+    for (std::size_t threads = 1; threads <= 8; ++threads) {
+        ASSERT_EQ(sum, parallel_reduce(x.begin(), x.end(), 5L, std::plus<long>(), threads));
+        ASSERT_EQ(999L, parallel_reduce(x.begin(), x.end(), 0L, [] (long a, long b) {return std::max(a, b);}, threads));}
+    ASSERT_EQ(5L, parallel_reduce(x.begin(), x.begin(), 5L, std::plus<long>(), 4));
+}
+
+TEST(TestParallel, sort)
+{
+    typedef my_deque<int, std::allocator<int>, 5> deque_type;
+    std::vector<int> v;
+    for (int i = 0; i < 2000; ++i)
+        v.push_back((i * 7919) % 503);
+    for (std::size_t threads = 1; threads <= 7; ++threads) {
+        deque_type x(v.begin(), v.end());
+        parallel_sort(x.begin() + 1, x.end(), std::greater<int>(), threads);
+        std::vector<int> w(v);
+        std::sort(w.begin() + 1, w.end(), std::greater<int>());
+        ASSERT_TRUE(std::equal(w.begin(), w.end(), x.begin()));}
+    deque_type x(v.begin(), v.end());
+    parallel_sort(x.begin(), x.end());
+    std::sort(v.begin(), v.end());
+    ASSERT_TRUE(std::equal(v.begin(), v.end(), x.begin()));
+}
+
+TEST(TestStats, empty)
+{
+    my_deque<int> x;
+    const deque_stats s = x.stats();
+    ASSERT_EQ(0u, s.size);
+    ASSERT_EQ(0u, s.blocks);
+    ASSERT_EQ(0u, s.map_slots);
+    ASSERT_EQ(0u, s.capacity);
+    ASSERT_EQ(0u, s.bytes_allocated);
+    ASSERT_EQ(0u, s.map_reallocations);
+    ASSERT_EQ(0u, s.high_water);
+}
+
+TEST(TestStats, layout)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    deque_type x;
+    for (int i = 0; i < 100; ++i)
+        x.push_back(i);
+    deque_stats s = x.stats();
+    ASSERT_EQ(100u, s.size);
+    ASSERT_EQ(7u, s.blocks);
+    ASSERT_EQ(0u, s.idle_blocks);
+    ASSERT_EQ(s.map_slots * 16, s.capacity);
+    ASSERT_EQ(s.capacity, s.front_slack + s.size + s.back_slack);
+    ASSERT_EQ(counting_allocator<int*>::allocations, s.map_reallocations);
+    ASSERT_EQ(100u, s.high_water);
+    ASSERT_EQ(counting_allocator<int>::live_bytes + counting_allocator<int*>::live_bytes, s.bytes_allocated);
+
+    for (int i = 0; i < 50; ++i)
+        x.pop_front();
+    s = x.stats();
+    ASSERT_EQ(50u, s.size);
+    ASSERT_EQ(4u, s.blocks);
+    ASSERT_EQ(3u, s.spare_blocks);
+    ASSERT_EQ(100u, s.high_water);
+    ASSERT_EQ(counting_allocator<int>::live_bytes + counting_allocator<int*>::live_bytes, s.bytes_allocated);
+
+    x.resize(10);
+    s = x.stats();
+    ASSERT_EQ(4u, s.spare_blocks);
+    ASSERT_EQ(1u, s.blocks);
+    ASSERT_EQ(0u, s.idle_blocks);
+    ASSERT_EQ(counting_allocator<int>::live_bytes + counting_allocator<int*>::live_bytes, s.bytes_allocated);
+
+    const std::size_t reallocations = s.map_reallocations;
+    x.shrink_to_fit();
+    s = x.stats();
+    ASSERT_EQ(0u, s.spare_blocks);
+    ASSERT_EQ(1u, s.blocks);
+    ASSERT_EQ(1u, s.map_slots);
+    ASSERT_EQ(reallocations + 1, s.map_reallocations);
+    ASSERT_EQ(counting_allocator<int>::live_bytes + counting_allocator<int*>::live_bytes, s.bytes_allocated);
+}
+
+TEST(TestStats, high_water_through_every_growth_path)
+{
+    my_deque<int, std::allocator<int>, 4> x;
+    x.push_front(1);
+    ASSERT_EQ(1u, x.stats().high_water);
+    x.resize(10);
+    ASSERT_EQ(10u, x.stats().high_water);
+    x.push_front_resize(5, 2);
+    ASSERT_EQ(15u, x.stats().high_water);
+    std::vector<int> v(20, 3);
+    x.insert(x.begin(), v.begin(), v.end());
+    ASSERT_EQ(35u, x.stats().high_water);
+    x.insert(x.end(), v.begin(), v.end());
+    ASSERT_EQ(55u, x.stats().high_water);
+    x.insert(x.begin() + 10, 7);
+    ASSERT_EQ(56u, x.stats().high_water);
+    x.clear();
+    ASSERT_EQ(0u, x.stats().size);
+    ASSERT_EQ(56u, x.stats().high_water);
+}
+
+TEST(TestStats, counters_follow_the_storage)
+{
+    my_deque<int, std::allocator<int>, 4> x;
+    for (int i = 0; i < 40; ++i)
+        x.push_back(i);
+    const deque_stats s = x.stats();
+    ASSERT_LT(0u, s.map_reallocations);
+    my_deque<int, std::allocator<int>, 4> y(std::move(x));
+    ASSERT_EQ(s.map_reallocations, y.stats().map_reallocations);
+    ASSERT_EQ(40u, y.stats().high_water);
+    ASSERT_EQ(0u, x.stats().map_reallocations);
+    ASSERT_EQ(0u, x.stats().high_water);
+    x.push_back(1);
+    swap(x, y);
+    ASSERT_EQ(40u, x.stats().high_water);
+    ASSERT_EQ(1u, y.stats().high_water);
+}
+
+TEST(TestInline, small_deques_stay_off_the_heap)
+{
+    typedef my_deque<int, counting_allocator<int>, 16, 8> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i < 8; ++i)
+            x.push_back(i);
+        for (int round = 0; round < 100; ++round) {
+            ASSERT_EQ(round, x.front());
+            x.pop_front();
+            x.push_back(round + 8);}
+        deque_type y;
+        for (int i = 0; i < 8; ++i)
+            y.push_front(i);
+        for (int round = 0; round < 100; ++round) {
+            y.pop_back();
+            y.push_front(round);}
+        deque_type z(y);
+        z = x;
+        ASSERT_TRUE(z == x);
+        ASSERT_EQ(0u, x.stats().bytes_allocated);
+        ASSERT_EQ(8u, x.stats().capacity);
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::allocations);
+    ASSERT_EQ(0u, counting_allocator<int*>::allocations);
+}
+
+TEST(TestInline, spills_to_blocks)
+{
+    typedef my_deque<int, counting_allocator<int>, 16, 8> deque_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i < 6; ++i)
+            x.push_back(i);
+        x.push_front(-1);
+        x.push_front(-2);
+        ASSERT_EQ(0u, counting_allocator<int>::allocations);
+        x.push_front(-3);
+        ASSERT_EQ(1u, counting_allocator<int*>::allocations);
+        for (int i = 6; i < 100; ++i)
+            x.push_back(i);
+        ASSERT_EQ(103u, x.size());
+        for (int i = -3; i < 100; ++i)
+            ASSERT_EQ(i, x[i + 3]);
+        ASSERT_EQ(103, std::distance(x.begin(), x.end()));
+        x.resize(2);
+        x.shrink_to_fit();
+        ASSERT_GE(2u, counting_allocator<int>::live());
+        x.clear();
+        x.shrink_to_fit();
+        ASSERT_EQ(0u, counting_allocator<int>::live());
+        ASSERT_EQ(0u, counting_allocator<int*>::live());
+        x.push_back(5);
+        ASSERT_EQ(0u, counting_allocator<int>::live());
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+    ASSERT_EQ(0u, counting_allocator<int*>::live());
+}
+
+TEST(TestInline, move_copy_and_swap_across_representations)
+{
+    typedef my_deque<std::string, std::allocator<std::string>, 16, 4> deque_type;
+    deque_type small;
+    deque_type large;
+    for (int i = 0; i < 3; ++i)
+        small.push_back(std::to_string(i));
+    for (int i = 0; i < 40; ++i)
+        large.push_front(std::to_string(i));
+    const deque_type small_copy(small);
+    const deque_type large_copy(large);
+
+    deque_type moved(std::move(small));
+    ASSERT_TRUE(small.empty());
+    ASSERT_TRUE(moved == small_copy);
+    small = std::move(moved);
+    ASSERT_TRUE(small == small_copy);
+
+    swap(small, large);
+    ASSERT_TRUE(small == large_copy);
+    ASSERT_TRUE(large == small_copy);
+    large.swap(small);
+    ASSERT_TRUE(small == small_copy);
+    ASSERT_TRUE(large == large_copy);
+
+    deque_type other(small_copy);
+    small.push_back("x");
+    swap(small, other);
+    ASSERT_EQ(4u, other.size());
+    ASSERT_EQ("x", other.back());
+    ASSERT_TRUE(small == small_copy);
+
+    large = small;
+    ASSERT_TRUE(large == small_copy);
+    small = large_copy;
+    ASSERT_TRUE(small == large_copy);
+}
+
+TEST(TestInline, destroys_every_element)
+{
+    typedef my_deque<life_counter, std::allocator<life_counter>, 8, 5> deque_type;
+    life_counter::alive = 0;
+    {
+        deque_type x;
+        for (int i = 0; i < 5; ++i)
+            x.emplace_back(i);
+        deque_type y(std::move(x));
+        ASSERT_EQ(5, life_counter::alive);
+        y.emplace_front(-1);
+        ASSERT_EQ(6, life_counter::alive);
+        y.erase(y.begin() + 2, y.end());
+        ASSERT_EQ(2, life_counter::alive);
+        x = y;
+        ASSERT_EQ(4, life_counter::alive);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+}
+
+// --------------
+// TestAllocators
+// --------------
+
+TEST(TestAllocators, map_and_blocks_come_from_the_arena)
+{
+    typedef my_deque<int, arena_allocator<int, true>, 8> deque_type;
+    arena a(1 << 16);
+    {
+        deque_type x((arena_allocator<int, true>(a)));
+        for (int i = 0; i < 100; ++i) {
+            x.push_back(i);
+            x.push_front(-i);}
+        deque_type y(10, 7, arena_allocator<int, true>(a));
+        deque_type z(x.begin(), x.end(), arena_allocator<int, true>(a));
+        ASSERT_TRUE(x == z);
+        ASSERT_EQ(&a, x.get_allocator()._arena);
+        ASSERT_TRUE(a.owns(&x.front()));
+        ASSERT_TRUE(a.owns(&y.back()));
+        ASSERT_TRUE(a.owns(&z[100]));
+    }
+    ASSERT_NE(0u, a.allocations);
+    ASSERT_EQ(a.allocations, a.deallocations);
+}
+
+TEST(TestAllocators, copy_construction_selects_the_allocator)
+{
+    arena a(1 << 16);
+    my_deque<int, arena_allocator<int, true>, 8>  x((arena_allocator<int, true>(a)));
+    my_deque<int, arena_allocator<int, false>, 8> y((arena_allocator<int, false>(a)));
+    x.assign(20, 1);
+    y.assign(20, 2);
+    const my_deque<int, arena_allocator<int, true>, 8>  x_copy(x);
+    const my_deque<int, arena_allocator<int, false>, 8> y_copy(y);
+    ASSERT_EQ(&a, x_copy.get_allocator()._arena);
+    ASSERT_EQ(0,  y_copy.get_allocator()._arena);
+    ASSERT_FALSE(a.owns(&y_copy.front()));
+    ASSERT_TRUE(y_copy == y);
+
+    const my_deque<int, arena_allocator<int, false>, 8> y_on_arena(y_copy, arena_allocator<int, false>(a));
+    ASSERT_TRUE(a.owns(&y_on_arena.front()));
+    ASSERT_TRUE(y_on_arena == y);
+}
+
+TEST(TestAllocators, assignment_follows_the_propagate_traits)
+{
+    arena a(1 << 16);
+    arena b(1 << 16);
+    {
+        my_deque<int, arena_allocator<int, true>, 8> x((arena_allocator<int, true>(a)));
+        my_deque<int, arena_allocator<int, true>, 8> y((arena_allocator<int, true>(b)));
+        x.assign(30, 1);
+        y.assign(10, 2);
+        x = y;
+        ASSERT_EQ(&b, x.get_allocator()._arena);
+        ASSERT_TRUE(b.owns(&x.front()));
+        x.assign(40, 3);
+        y = std::move(x);
+        ASSERT_EQ(40u, y.size());
+        ASSERT_TRUE(b.owns(&y.back()));
+    }
+    {
+        my_deque<int, arena_allocator<int, false>, 8> x((arena_allocator<int, false>(a)));
+        my_deque<int, arena_allocator<int, false>, 8> y((arena_allocator<int, false>(b)));
+        x.assign(30, 1);
+        y.assign(10, 2);
+        x = y;
+        ASSERT_EQ(&a, x.get_allocator()._arena);
+        ASSERT_TRUE(a.owns(&x.front()));
+        y.assign(40, 3);
+        x = std::move(y);
+        ASSERT_EQ(&a, x.get_allocator()._arena);
+        ASSERT_EQ(40u, x.size());
+        ASSERT_TRUE(a.owns(&x.back()));
+        ASSERT_TRUE(y.empty());
+    }
+    ASSERT_EQ(a.allocations, a.deallocations);
+    ASSERT_EQ(b.allocations, b.deallocations);
+}
+
+TEST(TestAllocators, swap_and_move_with_an_allocator)
+{
+    arena a(1 << 16);
+    arena b(1 << 16);
+    {
+        my_deque<int, arena_allocator<int, true>, 8> x((arena_allocator<int, true>(a)));
+        my_deque<int, arena_allocator<int, true>, 8> y((arena_allocator<int, true>(b)));
+        x.assign(30, 1);
+        y.assign(10, 2);
+        swap(x, y);
+        ASSERT_EQ(&b, x.get_allocator()._arena);
+        ASSERT_EQ(&a, y.get_allocator()._arena);
+        ASSERT_EQ(10u, x.size());
+        ASSERT_TRUE(b.owns(&x.front()));
+    }
+    {
+        my_deque<int, arena_allocator<int, false>, 8> x((arena_allocator<int, false>(a)));
+        my_deque<int, arena_allocator<int, false>, 8> y((arena_allocator<int, false>(b)));
+        x.assign(30, 1);
+        y.assign(10, 2);
+        swap(x, y);
+        ASSERT_EQ(&a, x.get_allocator()._arena);
+        ASSERT_EQ(10u, x.size());
+        ASSERT_TRUE(a.owns(&x.front()));
+        ASSERT_TRUE(b.owns(&y.front()));
+
+        my_deque<int, arena_allocator<int, false>, 8> stolen(std::move(x), arena_allocator<int, false>(a));
+        ASSERT_EQ(10u, stolen.size());
+        ASSERT_TRUE(x.empty());
+        my_deque<int, arena_allocator<int, false>, 8> moved(std::move(y), arena_allocator<int, false>(a));
+        ASSERT_EQ(30u, moved.size());
+        ASSERT_TRUE(a.owns(&moved.front()));
+        ASSERT_TRUE(y.empty());
+    }
+    ASSERT_EQ(a.allocations, a.deallocations);
+    ASSERT_EQ(b.allocations, b.deallocations);
+}
+
+// -------------
+// TestRingDeque
+// -------------
+
+TEST(TestRingDeque, allocates_only_when_constructed)
+{
+    typedef ring_deque<int, counting_allocator<int>, 4> ring_type;
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    {
+        ring_type x(10);
+        ASSERT_EQ(3u, counting_allocator<int>::allocations);
+        ASSERT_EQ(1u, counting_allocator<int*>::allocations);
+        for (int i = 0; i < 1000; ++i) {
+            x.push_back_overwrite(i);
+            if (i % 3 == 0)
+                x.pop_front();
+            if (i % 7 == 0)
+                x.push_front(-i);}
+        ASSERT_EQ(3u, counting_allocator<int>::allocations);
+        ASSERT_EQ(1u, counting_allocator<int*>::allocations);
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+    ASSERT_EQ(0u, counting_allocator<int*>::live());
+}
+
+TEST(TestRingDeque, try_push_back_refuses_when_full)
+{
+    ring_deque<int, std::allocator<int>, 4> x(5);
+    for (int i = 0; i < 5; ++i)
+        ASSERT_TRUE(x.try_push_back(i));
+    ASSERT_TRUE(x.full());
+    ASSERT_FALSE(x.try_push_back(5));
+    ASSERT_FALSE(x.push_front(-1));
+    ASSERT_EQ(5u, x.size());
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(i, x[i]);
+    int v = -1;
+    ASSERT_TRUE(x.try_pop_front(v));
+    ASSERT_EQ(0, v);
+    ASSERT_TRUE(x.push_front(-1));
+    ASSERT_EQ(-1, x.front());
+    ASSERT_EQ(4, x.back());
+}
+
+TEST(TestRingDeque, overwrite_drops_the_oldest)
+{
+    ring_deque<std::string, std::allocator<std::string>, 3> x(7);
+    std::deque<std::string> y;
+    for (int i = 0; i < 100; ++i) {
+        const bool full = (y.size() == 7);
+        ASSERT_EQ(full, x.push_back_overwrite(std::to_string(i)));
+        y.push_back(std::to_string(i));
+        if (y.size() > 7)
+            y.pop_front();
+        if (i % 11 == 0) {
+            x.pop_back();
+            y.pop_back();}
+        ASSERT_EQ(y.size(), x.size());
+        for (std::size_t j = 0; j != y.size(); ++j)
+            ASSERT_EQ(y[j], x[j]);}
+    x.clear();
+    ASSERT_TRUE(x.empty());
+    ASSERT_TRUE(x.try_push_back("a"));
+    ASSERT_EQ("a", x.front());
+}
+
+TEST(TestRingDeque, destroys_every_element)
+{
+    life_counter::alive = 0;
+    {
+        ring_deque<life_counter, std::allocator<life_counter>, 2> x(5);
+        for (int i = 0; i < 17; ++i)
+            x.push_back_overwrite(life_counter(i));
+        ASSERT_EQ(5, life_counter::alive);
+        ASSERT_EQ(12, x.front().value);
+        x.pop_front();
+        x.push_front(life_counter(-1));
+        x.pop_back();
+        ASSERT_EQ(4, life_counter::alive);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+    ring_deque<int> empty(0);
+    ASSERT_FALSE(empty.try_push_back(1));
+    ASSERT_TRUE(empty.push_back_overwrite(1));
+    ASSERT_TRUE(empty.empty());
+}
+
+// ----------
+// TestShrink
+// ----------
+
+TEST(TestShrink, off_by_default)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    ASSERT_EQ(0u, x.shrink_threshold());
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    const std::size_t map_slots = x.stats().map_slots;
+    while (x.size() > 10)
+        x.pop_front();
+    ASSERT_EQ(map_slots, x.stats().map_slots);
+}
+
+TEST(TestShrink, drained_deque_gives_memory_back)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    x.set_shrink_threshold(1);
+    ASSERT_EQ(4u, x.shrink_threshold());
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    const deque_stats peak = x.stats();
+    while (x.size() > 10)
+        x.pop_front();
+    const deque_stats drained = x.stats();
+    ASSERT_GT(peak.map_slots / 10, drained.map_slots);
+    ASSERT_EQ(0u, drained.spare_blocks);
+    ASSERT_EQ(0u, drained.idle_blocks);
+    ASSERT_GT(peak.bytes_allocated / 10, drained.bytes_allocated);
+    for (int i = 0; i < 10; ++i)
+        ASSERT_EQ(9990 + i, x[i]);
+
+    for (int i = 0; i < 10000; ++i)
+        x.push_front(i);
+    x.resize(20);
+    ASSERT_GT(peak.map_slots / 10, x.stats().map_slots);
+    x.erase(x.begin() + 1, x.end() - 1);
+    ASSERT_EQ(9999, x.front());
+    ASSERT_EQ(9980, x.back());
+    x.clear();
+    ASSERT_GE(16u, x.stats().map_slots);
+}
+
+TEST(TestShrink, hysteresis_stops_thrashing)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    x.set_shrink_threshold(4);
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    while (x.size() > 100)
+        x.pop_back();
+    const std::size_t reallocations = x.stats().map_reallocations;
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 60; ++i) {
+            x.push_back(i);
+            x.push_front(i);}
+        for (int i = 0; i < 60; ++i) {
+            x.pop_back();
+            x.pop_front();}}
+    ASSERT_EQ(reallocations, x.stats().map_reallocations);
+    ASSERT_EQ(100u, x.size());
+}
+
+TEST(TestShrink, clear_recenters)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_back(i);
+    x.clear();
+    const deque_stats s = x.stats();
+    ASSERT_EQ(s.front_slack, s.back_slack);
+    const std::size_t reallocations = s.map_reallocations;
+    for (int i = 0; i < 400; ++i) {
+        x.push_front(i);
+        x.push_back(i);}
+    ASSERT_EQ(reallocations, x.stats().map_reallocations);
+}
+
+// -------------
+// TestSerialize
+// -------------
+
+/**
+ * Writes a life_counter as its value.
+ */
+struct life_counter_codec {
+    void write (std::ostream& out, const life_counter& v) const {
+        out << v.value << ' ';}
+
+    life_counter read (std::istream& in) const {
+        int v = 0;
+        in >> v;
+        return life_counter(v);}};
+
+TEST(TestSerialize, raw_bytes_round_trip)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    for (int i = 0; i < 1000; ++i) {
+        x.push_back(i);
+        x.push_front(-i);}
+    std::stringstream stream;
+    x.save(stream);
+    ASSERT_EQ(sizeof(deque_header) + 2000 * sizeof(int), stream.str().size());
+    my_deque<int, std::allocator<int>, 8> y(3, 7);
+    y.load(stream);
+    ASSERT_TRUE(stream.good());
+    ASSERT_TRUE(x == y);
+
+    my_deque<int, std::allocator<int>, 8> empty;
+    std::stringstream nothing;
+    empty.save(nothing);
+    y.load(nothing);
+    ASSERT_TRUE(y.empty());
+
+    my_deque<double, std::allocator<double>, 16, 8> small;
+    small.push_back(1.5);
+    small.push_front(2.5);
+    std::stringstream inline_stream;
+    small.save(inline_stream);
+    my_deque<double, std::allocator<double>, 16, 8> small_copy;
+    small_copy.load(inline_stream);
+    ASSERT_TRUE(small == small_copy);
+}
+
+TEST(TestSerialize, load_sizes_storage_once)
+{
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    deque_type x;
+    for (int i = 0; i < 1000; ++i)
+        x.push_back(i);
+    std::stringstream stream;
+    x.save(stream);
+    counting_allocator<int>::reset();
+    counting_allocator<int*>::reset();
+    deque_type y;
+    y.load(stream);
+    ASSERT_TRUE(x == y);
+    ASSERT_EQ(1u, counting_allocator<int*>::allocations);
+    ASSERT_GE(64u, counting_allocator<int>::allocations);
+}
+
+TEST(TestSerialize, codecs)
+{
+    my_deque<std::string, std::allocator<std::string>, 4> x;
+    for (int i = 0; i < 100; ++i)
+        x.push_front(std::string(i * 100, 'a' + i % 26));
+    std::stringstream stream;
+    x.save(stream);
+    my_deque<std::string, std::allocator<std::string>, 4> y;
+    y.load(stream);
+    ASSERT_TRUE(x == y);
+
+    life_counter::alive = 0;
+    {
+        my_deque<life_counter, std::allocator<life_counter>, 3> a;
+        for (int i = 0; i < 20; ++i)
+            a.emplace_back(i);
+        std::stringstream text;
+        a.save(text, life_counter_codec());
+        my_deque<life_counter, std::allocator<life_counter>, 3> b;
+        b.load(text, life_counter_codec());
+        ASSERT_EQ(20u, b.size());
+        for (int i = 0; i < 20; ++i)
+            ASSERT_EQ(i, b[i].value);
+        ASSERT_EQ(40, life_counter::alive);
+    }
+    ASSERT_EQ(0, life_counter::alive);
+}
+
+TEST(TestSerialize, bad_input_leaves_the_deque_alone)
+{
+    my_deque<int, std::allocator<int>, 8> x(50, 1);
+    std::stringstream stream;
+    x.save(stream);
+    const std::string bytes = stream.str();
+
+    my_deque<int, std::allocator<int>, 8> y(5, 2);
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+    y.load(truncated);
+    ASSERT_TRUE(truncated.fail());
+    ASSERT_EQ(5u, y.size());
+    ASSERT_EQ(2, y.back());
+
+    std::stringstream wrong_type(bytes);
+    my_deque<double, std::allocator<double>, 8> z(5, 2);
+    z.load(wrong_type);
+    ASSERT_TRUE(wrong_type.fail());
+    ASSERT_EQ(5u, z.size());
+
+    std::string corrupt = bytes;
+    corrupt[0] = 'X';
+    std::stringstream bad_magic(corrupt);
+    y.load(bad_magic);
+    ASSERT_TRUE(bad_magic.fail());
+    ASSERT_EQ(5u, y.size());
+
+    my_deque<std::string> strings;
+    std::stringstream raw(bytes);
+    strings.load(raw);
+    ASSERT_TRUE(raw.fail());
+}
+
+// ---------------
+// TestMappedDeque
+// ---------------
+
+/**
+ * A file name of its own for each test, removed when the test ends.
+ */
+struct temp_file {
+    std::string path;
+
+    explicit temp_file (const char* name) :
+            path ("/tmp/TestDeque." + std::to_string(getpid()) + "." + name) {
+        unlink(path.c_str());}
+
+    ~temp_file () {
+        unlink(path.c_str());}};
+
+TEST(TestMappedDeque, fifo_across_blocks)
+{
+    temp_file f("fifo");
+    mapped_deque<int, 1024> x(f.path, 1 << 26);
+    ASSERT_TRUE(x.empty());
+    for (int i = 0; i < 10000; ++i)
+        x.push_back(i);
+    ASSERT_EQ(10000u, x.size());
+    ASSERT_EQ(49995000, std::accumulate(x.begin(), x.end(), 0));
+    for (int i = 0; i < 9000; ++i) {
+        ASSERT_EQ(i, x.front());
+        x.pop_front();}
+    for (int i = 10000; i < 20000; ++i)
+        x.push_back(i);
+    ASSERT_EQ(9000, x[0]);
+    ASSERT_EQ(19999, x.back());
+    x.pop_back();
+    ASSERT_EQ(19998, x.back());
+    ASSERT_EQ(10999u, x.size());
+    ASSERT_EQ(static_cast<std::ptrdiff_t>(x.size()), std::distance(x.begin(), x.end()));
+}
+
+TEST(TestMappedDeque, reopens_in_place)
+{
+    temp_file f("reopen");
+    {
+        mapped_deque<double, 512> x(f.path, 1 << 26);
+        for (int i = 0; i < 5000; ++i)
+            x.push_back(i * 0.5);
+        for (int i = 0; i < 1234; ++i)
+            x.pop_front();
+        x.flush();
+    }
+    {
+        mapped_deque<double, 512> x(f.path, 1 << 26);
+        ASSERT_EQ(3766u, x.size());
+        ASSERT_EQ(1234 * 0.5, x.front());
+        ASSERT_EQ(4999 * 0.5, x.back());
+        x.push_back(-1);
+    }
+    mapped_deque<double, 512> x(f.path, 1 << 26);
+    ASSERT_EQ(3767u, x.size());
+    ASSERT_EQ(-1, x.back());
+}
+
+TEST(TestMappedDeque, empties_back_to_a_small_file)
+{
+    temp_file f("empty");
+    mapped_deque<int, 1024> x(f.path, 1 << 26);
+    for (int i = 0; i < 100000; ++i)
+        x.push_back(i);
+    const std::size_t full = x.file_bytes();
+    while (!x.empty())
+        x.pop_front();
+    ASSERT_GT(full / 10, x.file_bytes());
+    x.push_back(7);
+    ASSERT_EQ(7, x.front());
+    ASSERT_THROW((mapped_deque<int, 1024>(f.path, 1 << 12)), std::length_error);
+}
+
+TEST(TestMappedDeque, rejects_a_mismatched_file)
+{
+    temp_file f("mismatch");
+    {
+        mapped_deque<int, 1024> x(f.path, 1 << 26);
+        x.push_back(1);
+    }
+    ASSERT_THROW((mapped_deque<double, 1024>(f.path, 1 << 26)), std::runtime_error);
+    ASSERT_THROW((mapped_deque<int, 2048>(f.path, 1 << 26)), std::runtime_error);
+    ASSERT_THROW((mapped_deque<int, 3>(f.path, 1 << 26)), std::invalid_argument);
+    ASSERT_THROW((mapped_deque<int, 1024>("/nonexistent/dir/file", 1 << 26)), std::system_error);
+}
+
+// ------------
+// TestSegments
+// ------------
+
+TEST(TestSegments, spans_cover_the_range)
+{
+    typedef my_deque<int, std::allocator<int>, 8> deque_type;
+    deque_type x;
+    for (int i = 0; i < 100; ++i) {
+        x.push_back(i);
+        x.push_front(-i);}
+    for (std::size_t b = 0; b < 40; b += 3)
+        for (std::size_t e = b; e < 60; e += 5) {
+            std::vector<int> flat;
+            std::size_t runs = 0;
+            for (const deque_span<int*> span : segments(x.begin() + b, x.begin() + e)) {
+                ASSERT_LT(0u, span.size);
+                ASSERT_GE(8u, span.size);
+                flat.insert(flat.end(), span.data, span.data + span.size);
+                ++runs;}
+            ASSERT_EQ(runs, segments(x.begin() + b, x.begin() + e).size());
+            ASSERT_TRUE(std::equal(flat.begin(), flat.end(), x.begin() + b));
+            ASSERT_EQ(e - b, flat.size());}
+
+    const deque_type& y = x;
+    int sum = 0;
+    for (const deque_span<const int*> span : y.segments_front(y.size()))
+        sum = std::accumulate(span.data, span.data + span.size, sum);
+    ASSERT_EQ(std::accumulate(x.begin(), x.end(), 0), sum);
+
+    deque_type empty;
+    ASSERT_TRUE(segments(empty.begin(), empty.end()).empty());
+    ASSERT_TRUE(empty.segments_front(0).empty());
+}
+
+TEST(TestSegments, consume_front)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    for (int i = 0; i < 50; ++i)
+        x.push_back(i);
+    std::size_t runs = x.segments_front(20).size();
+    ASSERT_EQ(3u, runs);
+    x.consume_front(20);
+    ASSERT_EQ(30u, x.size());
+    ASSERT_EQ(20, x.front());
+    x.consume_front(30);
+    ASSERT_TRUE(x.empty());
+}
+
+TEST(TestSegments, prepare_and_commit_back)
+{
+    my_deque<int, std::allocator<int>, 8> x;
+    x.push_back(-1);
+    deque_segments<int, int&, int*, 8> room = x.prepare_back(20);
+    int i = 0;
+    for (const deque_span<int*> span : room)
+        for (std::size_t j = 0; j != span.size; ++j)
+            span.data[j] = i++;
+    ASSERT_EQ(20, i);
+    ASSERT_EQ(1u, x.size());
+    x.commit_back(15);
+    ASSERT_EQ(16u, x.size());
+    for (int k = 0; k < 15; ++k)
+        ASSERT_EQ(k, x[k + 1]);
+    x.prepare_back(0);
+    x.commit_back(0);
+    ASSERT_EQ(16u, x.size());
+}
+
+TEST(TestSegments, scatter_gather_through_a_pipe)
+{
+    typedef my_deque<char, std::allocator<char>, 16> deque_type;
+    deque_type out;
+    for (int i = 0; i < 200; ++i)
+        out.push_front(static_cast<char>('a' + i % 26));
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    std::vector<iovec> gather;
+    for (const deque_span<char*> span : out.segments_front(out.size())) {
+        const iovec v = {span.data, span.size};
+        gather.push_back(v);}
+    ASSERT_EQ(200, writev(fds[1], gather.data(), static_cast<int>(gather.size())));
+    out.consume_front(150);
+    ASSERT_EQ(50u, out.size());
+
+    deque_type in;
+    in.push_back('!');
+    std::vector<iovec> scatter;
+    for (const deque_span<char*> span : in.prepare_back(200)) {
+        const iovec v = {span.data, span.size};
+        scatter.push_back(v);}
+    const ssize_t n = readv(fds[0], scatter.data(), static_cast<int>(scatter.size()));
+    ASSERT_EQ(200, n);
+    in.commit_back(static_cast<std::size_t>(n));
+    close(fds[0]);
+    close(fds[1]);
+    ASSERT_EQ(201u, in.size());
+    ASSERT_EQ('!', in.front());
+    ASSERT_TRUE(std::equal(out.begin(), out.end(), in.begin() + 151));
+}
+
+// -----------
+// TestCompare
+// -----------
+
+namespace {
+    typedef my_deque<int, std::allocator<int>, 7> small_int_deque;
+
+    /**
+     * 0 to n - 1 pushed at the back, and the same built from the front,
+     * so the two deques' blocks break in different places.
+     */
+    void misaligned (small_int_deque& x, small_int_deque& y, int n) {
+        for (int i = 0; i != n; ++i)
+            x.push_back(i);
+        for (int i = n; i != 0; --i)
+            y.push_front(i - 1);}}
+
+TEST(TestCompare, equality_across_misaligned_blocks) {
+    small_int_deque x;
+    small_int_deque y;
+    misaligned(x, y, 100);
+    ASSERT_NE(x.begin().local() - *x.begin().segment(), y.begin().local() - *y.begin().segment());
+    ASSERT_TRUE(x == y);
+    for (int i = 0; i < 100; i += 13) {
+        ++y[i];
+        ASSERT_FALSE(x == y);
+        --y[i];}
+    ASSERT_TRUE(x == y);
+    y.pop_back();
+    ASSERT_FALSE(x == y);
+    x.pop_back();
+    ASSERT_TRUE(x == y);
+    ASSERT_TRUE(small_int_deque() == small_int_deque());
+}
+
+TEST(TestCompare, ordering_matches_lexicographical_compare) {
+    small_int_deque x;
+    small_int_deque y;
+    misaligned(x, y, 60);
+    ASSERT_FALSE(x < y);
+    ASSERT_FALSE(y < x);
+    y[40] = -1;
+    ASSERT_TRUE(y < x);
+    ASSERT_FALSE(x < y);
+    y[40] = 40;
+    y.pop_back();
+    ASSERT_TRUE(y < x);
+    ASSERT_TRUE(small_int_deque() < x);
+    my_deque<unsigned char, std::allocator<unsigned char>, 5> a(23, 7);
+    my_deque<unsigned char, std::allocator<unsigned char>, 5> b(a);
+    b.push_front(7);
+    b.pop_back();
+    b[17] = 200;
+    ASSERT_TRUE(a < b);
+    ASSERT_FALSE(b < a);
+}
+
+TEST(TestCompare, floating_point_is_not_compared_bitwise) {
+    my_deque<double, std::allocator<double>, 3> x(10, 1.5);
+    my_deque<double, std::allocator<double>, 3> y(10, 1.5);
+    x[4] = 0.0;
+    y[4] = -0.0;
+    ASSERT_TRUE(x == y);
+    ASSERT_FALSE(x < y);
+    ASSERT_FALSE(y < x);
+    x[7] = y[7] = std::numeric_limits<double>::quiet_NaN();
+    ASSERT_FALSE(x == y);
+    x[8] = 2.0;
+    ASSERT_TRUE(y < x);
+}
+
+TEST(TestCompare, hash_follows_equality) {
+    small_int_deque x;
+    small_int_deque y;
+    misaligned(x, y, 100);
+    const std::hash<small_int_deque> h;
+    ASSERT_EQ(h(x), h(y));
+    ++y[50];
+    ASSERT_NE(h(x), h(y));
+    ASSERT_NE(h(small_int_deque()), h(small_int_deque(1, 0)));
+    my_deque<double> d(3, 0.0);
+    my_deque<double> e(3, -0.0);
+    ASSERT_EQ(std::hash< my_deque<double> >()(d), std::hash< my_deque<double> >()(e));
+    my_deque<std::string> s = {"a", "bc"};
+    my_deque<std::string> t = {"ab", "c"};
+    ASSERT_NE(std::hash< my_deque<std::string> >()(s), std::hash< my_deque<std::string> >()(t));
+}
+
+// -----------
+// TestBulkPop
+// -----------
+
+TEST(TestBulkPop, pop_n_at_either_end) {
+    my_deque<int, std::allocator<int>, 5> x;
+    std::deque<int>                       y;
+    for (int i = 0; i != 100; ++i) {
+        x.push_back(i);
+        y.push_back(i);}
+    x.pop_front(23);
+    y.erase(y.begin(), y.begin() + 23);
+    x.pop_back(31);
+    y.erase(y.end() - 31, y.end());
+    x.pop_front(0);
+    x.pop_back(0);
+    ASSERT_EQ(y.size(), x.size());
+    ASSERT_TRUE(std::equal(y.begin(), y.end(), x.begin()));
+    x.pop_back(x.size());
+    ASSERT_TRUE(x.empty());
+    x.push_front(7);
+    x.push_back(8);
+    ASSERT_EQ(7, x.front());
+    ASSERT_EQ(8, x.back());
+}
+
+TEST(TestBulkPop, drain_front_moves_front_first) {
+    my_deque<std::string, std::allocator<std::string>, 3> x;
+    for (int i = 0; i != 20; ++i)
+        x.push_back(std::string(30, static_cast<char>('a' + i)));
+    std::vector<std::string> out;
+    x.drain_front(8, std::back_inserter(out));
+    ASSERT_EQ(8u, out.size());
+    ASSERT_EQ(std::string(30, 'a'), out.front());
+    ASSERT_EQ(std::string(30, 'h'), out.back());
+    ASSERT_EQ(12u, x.size());
+    ASSERT_EQ(std::string(30, 'i'), x.front());
+    x.drain_front(12, std::back_inserter(out));
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(std::string(30, 't'), out.back());
+}
+
+TEST(TestBulkPop, drain_back_moves_back_first) {
+    my_deque<int, std::allocator<int>, 16, 8> x;
+    for (int i = 0; i != 50; ++i)
+        x.push_front(i);
+    int out[30];
+    ASSERT_EQ(out + 20, x.drain_back(20, out));
+    for (int i = 0; i != 20; ++i)
+        ASSERT_EQ(i, out[i]);
+    ASSERT_EQ(30u, x.size());
+    ASSERT_EQ(20, x.back());
+    ASSERT_EQ(49, x.front());
+    x.drain_back(30, out);
+    ASSERT_TRUE(x.empty());
+    ASSERT_EQ(49, out[29]);
+}
+
+TEST(TestBulkPop, drained_blocks_are_released) {
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    counting_allocator<int>::reset();
+    {
+        deque_type x;
+        for (int i = 0; i != 320; ++i)
+            x.push_back(i);
+        ASSERT_GE(counting_allocator<int>::live(), 20u);
+        std::vector<int> out;
+        x.drain_front(300, std::back_inserter(out));
+        ASSERT_EQ(299, out.back());
+        ASSERT_LE(counting_allocator<int>::live(), 2 + deque_type::spare_limit);
+        x.pop_back(20);
+        ASSERT_LE(counting_allocator<int>::live(), 1 + deque_type::spare_limit);
+    }
+    ASSERT_EQ(0u, counting_allocator<int>::live());
+}
+
+// -----------
+// TestReserve
+// -----------
+
+TEST(TestReserve, pushes_after_reserve_back_do_not_allocate) {
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    deque_type x;
+    for (int i = 0; i != 5; ++i) {
+        x.push_front(-i);
+        x.push_back(i);}
+    x.reserve_back(1000);
+    ASSERT_GE(x.capacity_back(), 1000u);
+    const std::size_t blocks = counting_allocator<int>::allocations;
+    const std::size_t maps   = counting_allocator<int*>::allocations;
+    for (int i = 0; i != 1000; ++i)
+        x.push_back(i);
+    ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    ASSERT_EQ(maps,   counting_allocator<int*>::allocations);
+    ASSERT_EQ(1010u, x.size());
+    ASSERT_EQ(-4, x.front());
+    ASSERT_EQ(999, x.back());
+}
+
+TEST(TestReserve, pushes_after_reserve_front_do_not_allocate) {
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    deque_type x(7, 3);
+    x.reserve_front(1000);
+    ASSERT_GE(x.capacity_front(), 1000u);
+    const std::size_t blocks = counting_allocator<int>::allocations;
+    const std::size_t maps   = counting_allocator<int*>::allocations;
+    for (int i = 0; i != 1000; ++i)
+        x.push_front(i);
+    ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    ASSERT_EQ(maps,   counting_allocator<int*>::allocations);
+    ASSERT_EQ(999, x.front());
+    ASSERT_EQ(3, x.back());
+}
+
+TEST(TestReserve, both_ends_keep_their_room) {
+    typedef my_deque<int, counting_allocator<int>, 16> deque_type;
+    deque_type x;
+    x.reserve_back(500);
+    x.reserve_front(500);
+    ASSERT_GE(x.capacity_back(), 500u);
+    ASSERT_GE(x.capacity_front(), 500u);
+    const std::size_t blocks = counting_allocator<int>::allocations;
+    const std::size_t maps   = counting_allocator<int*>::allocations;
+    for (int i = 0; i != 500; ++i) {
+        x.push_back(i);
+        x.push_front(-i);}
+    ASSERT_EQ(blocks, counting_allocator<int>::allocations);
+    ASSERT_EQ(maps,   counting_allocator<int*>::allocations);
+    ASSERT_EQ(1000u, x.size());
+}
+
+TEST(TestReserve, capacities) {
+    my_deque<int> x;
+    ASSERT_EQ(0u, x.capacity_back());
+    ASSERT_EQ(0u, x.capacity_front());
+    x.reserve_back(0);
+    x.reserve_front(0);
+    ASSERT_EQ(0u, x.capacity_back());
+    x.push_back(1);
+    const std::size_t room = x.capacity_back();
+    ASSERT_GE(room, 1u);
+    x.push_back(2);
+    ASSERT_EQ(room - 1, x.capacity_back());
+    my_deque<int, std::allocator<int>, 16, 8> y;
+    ASSERT_EQ(8u, y.capacity_back());
+    ASSERT_EQ(8u, y.capacity_front());
+    y.push_back(1);
+    y.push_front(0);
+    ASSERT_EQ(6u, y.capacity_back());
+    y.reserve_front(20);
+    ASSERT_GE(y.capacity_front(), 20u);
+    ASSERT_EQ(0, y.front());
+    ASSERT_EQ(1, y.back());
+}
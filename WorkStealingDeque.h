@@ -0,0 +1,252 @@
+// ----------------------------------
+// projects/deque/WorkStealingDeque.h
+// Copyright (C) 2014
+// Glenn P. Downing
+// ----------------------------------
+
+#ifndef WorkStealingDeque_h
+#define WorkStealingDeque_h
+
+// --------
+// includes
+// --------
+
+#include <atomic>      // atomic, atomic_thread_fence, memory_order
+#include <cstddef>     // ptrdiff_t, size_t
+#include <memory>      // allocator, allocator_traits
+#include <new>         // placement new
+#include <type_traits> // is_trivially_copyable
+
+#include "Deque.h"
+
+// -------------------
+// work_stealing_deque
+// -------------------
+
+/**
+ * Chase-Lev work-stealing deque over a map of B-element blocks.
+ * The owning thread calls push_back and pop_back without locks; any other
+ * thread may call steal, which takes the front element with a single CAS.
+ *
+ * Logical block k lives in map slot k % nodes. When the owner runs out of
+ * slots it publishes a map twice the size that holds the same block
+ * pointers, so no element is copied. A thief can still be reading a map
+ * that has been replaced, so replaced maps are kept until the destructor.
+ * Together they are smaller than the current map.
+ *
+ * Elements are std::atomic<T>, so T must be trivially copyable.
+ */
+template < typename T, typename A = std::allocator<T>, std::size_t B = deque_block_size<T>::value >
+class work_stealing_deque {
+    static_assert(B > 0, "work_stealing_deque block size must be positive");
+    static_assert(std::is_trivially_copyable<T>::value, "work_stealing_deque requires a trivially copyable T");
+
+    public:
+        // --------
+        // typedefs
+        // --------
+
+        typedef A                                       allocator_type;
+        typedef typename allocator_type::value_type     value_type;
+        typedef typename allocator_type::size_type      size_type;
+        typedef std::ptrdiff_t                          difference_type;
+
+    private:
+        typedef std::atomic<value_type> slot_type;
+
+        struct map_type {
+            slot_type** slots;
+            size_type   nodes;
+            map_type*   retired;};
+
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<slot_type>  block_alloc_type;
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<slot_type*> slots_alloc_type;
+        typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<map_type>   map_alloc_type;
+
+        /**
+         * Keeps the owner's and the thieves' indices on separate cache lines.
+         */
+        static const std::size_t cache_line = 64;
+
+        static const size_type initial_nodes = 2;
+
+    private:
+        // ----
+        // data
+        // ----
+
+        alignas(cache_line) std::atomic<difference_type> _b;
+        alignas(cache_line) std::atomic<difference_type> _e;
+        std::atomic<map_type*> _map;
+        block_alloc_type _a;
+        slots_alloc_type _s;
+        map_alloc_type   _m;
+
+    private:
+        /**
+         * The slot for absolute index i >= 0.
+         */
+        static slot_type& slot (map_type* m, difference_type i) {
+            return m->slots[(i / B) % m->nodes][i % B];}
+
+        /**
+         * <your documentation>
+         */
+        slot_type* new_block () {
+            slot_type* p = _a.allocate(B);
+            for (size_type i = 0; i != B; ++i)
+                ::new (static_cast<void*>(p + i)) slot_type();
+            return p;}
+
+        /**
+         * A map of n nodes, all null, that retires r.
+         */
+        map_type* new_map (size_type n, map_type* r) {
+            map_type* m = _m.allocate(1);
+            m->slots   = _s.allocate(n);
+            m->nodes   = n;
+            m->retired = r;
+            for (size_type i = 0; i != n; ++i)
+                m->slots[i] = 0;
+            return m;}
+
+        /**
+         * Publishes a map twice the size of m. The nodes blocks starting at
+         * logical block t / B, which cover every element from t on, keep their
+         * pointers; the new half of the map gets fresh blocks.
+         * Owner thread only.
+         */
+        map_type* grow (map_type* m, difference_type t) {
+            map_type* g = new_map(2 * m->nodes, m);
+            const size_type first = static_cast<size_type>(t / B);
+            for (size_type k = first; k != first + m->nodes; ++k)
+                g->slots[k % g->nodes] = m->slots[k % m->nodes];
+            for (size_type i = 0; i != g->nodes; ++i)
+                if (g->slots[i] == 0)
+                    g->slots[i] = new_block();
+            _map.store(g, std::memory_order_release);
+            return g;}
+
+    public:
+        // ------------
+        // constructors
+        // ------------
+
+        /**
+         * <your documentation>
+         */
+        explicit work_stealing_deque (const allocator_type& a = allocator_type()) :
+                _b (0),
+                _e (0),
+                _a (a),
+                _s (a),
+                _m (a) {
+            map_type* m = new_map(initial_nodes, 0);
+            for (size_type i = 0; i != m->nodes; ++i)
+                m->slots[i] = new_block();
+            _map.store(m, std::memory_order_relaxed);}
+
+        work_stealing_deque (const work_stealing_deque&) = delete;
+        work_stealing_deque& operator = (const work_stealing_deque&) = delete;
+
+        // ----------
+        // destructor
+        // ----------
+
+        /**
+         * Every block is in the current map; the retired maps only own their
+         * slot arrays. No other thread may be using the deque.
+         */
+        ~work_stealing_deque () {
+            map_type* m = _map.load(std::memory_order_relaxed);
+            for (size_type i = 0; i != m->nodes; ++i)
+                _a.deallocate(m->slots[i], B);
+            while (m != 0) {
+                map_type* r = m->retired;
+                _s.deallocate(m->slots, m->nodes);
+                _m.deallocate(m, 1);
+                m = r;}}
+
+        // -----
+        // owner
+        // -----
+
+        /**
+         * Adds v at the back. Owner thread only.
+         */
+        void push_back (const value_type& v) {
+            const difference_type e = _e.load(std::memory_order_relaxed);
+            const difference_type t = _b.load(std::memory_order_acquire);
+            map_type* m = _map.load(std::memory_order_relaxed);
+            if (static_cast<size_type>(e / B - t / B) >= m->nodes)
+                m = grow(m, t);
+            slot(m, e).store(v, std::memory_order_relaxed);
+            _e.store(e + 1, std::memory_order_release);}
+
+        /**
+         * Takes the back element into x. Owner thread only.
+         * Returns false, leaving x alone, when the deque is empty or a thief
+         * won the race for the last element.
+         */
+        bool pop_back (value_type& x) {
+            const difference_type e = _e.load(std::memory_order_relaxed) - 1;
+            map_type* m = _map.load(std::memory_order_relaxed);
+            _e.store(e, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            difference_type t = _b.load(std::memory_order_relaxed);
+            if (t > e) {
+                _e.store(e + 1, std::memory_order_relaxed);
+                return false;}
+            const value_type v = slot(m, e).load(std::memory_order_relaxed);
+            if (t == e) {
+                const bool won = _b.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                _e.store(e + 1, std::memory_order_relaxed);
+                if (!won)
+                    return false;}
+            x = v;
+            return true;}
+
+        // -----
+        // thief
+        // -----
+
+        /**
+         * Takes the front element into x. Any thread.
+         * Returns false, leaving x alone, when the deque is empty or another
+         * thread took the element first; callers should try again elsewhere.
+         */
+        bool steal (value_type& x) {
+            difference_type t = _b.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const difference_type e = _e.load(std::memory_order_acquire);
+            if (t >= e)
+                return false;
+            map_type* m = _map.load(std::memory_order_acquire);
+            const value_type v = slot(m, t).load(std::memory_order_relaxed);
+            if (!_b.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return false;
+            x = v;
+            return true;}
+
+        // ---------
+        // observers
+        // ---------
+
+        /**
+         * Only a snapshot while other threads are running.
+         */
+        size_type size () const {
+            const difference_type t = _b.load(std::memory_order_acquire);
+            const difference_type e = _e.load(std::memory_order_acquire);
+            return (e > t) ? static_cast<size_type>(e - t) : 0;}
+
+        /**
+         * <your documentation>
+         */
+        bool empty () const {
+            return size() == 0;}};
+
+template <typename T, typename A, std::size_t B>
+const typename work_stealing_deque<T, A, B>::size_type work_stealing_deque<T, A, B>::initial_nodes;
+
+#endif // WorkStealingDeque_h